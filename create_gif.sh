@@ -15,6 +15,7 @@ image_width=854
 image_height=480
 n_max_iter=32000
 magn_gain=1.25
+frame_delay=10 # 1/100 s
 
 # Predefined regions with its target magnification
 regions=(
@@ -45,61 +46,26 @@ function show_help() {
     echo "  -c, --custom width heigh real imag maxiter magn     Specify your own settings with size, center, max iter." 
     echo "                                                      and magn."
     echo ""
+    echo "The maximum number of iterations is chosen per frame, max iter. is its upper bound."
+    echo ""
 }
 
-generate_magn_steps() {
-    python -c "arr = [1]
-while arr[-1] < $target_magn:
-    arr.append(arr[-1]*$magn_gain)
-arr[-1] = $target_magn
-print('\n'.join(map(str, arr)))"
-}
-
-render_mandelbrot_images() {
-    local i=1
-    local magn_steps=$(generate_magn_steps)
-    local magn_steps_arr=($magn_steps)
-
-    for magn in $magn_steps; do
-        printf "\r * Processing images \t\033[34m %d \033[0m of \033[34m %d \033[0m  |  Magnification  \033[35m %.1e \033[0m" "$i" "${#magn_steps_arr[@]}" "$magn"
-
-        # Create a unique hash for each parameter set
-        input_string="${image_width}${image_height}${center_real}${center_imag}${n_max_iter}${magn}"
-        hash=$(echo -n "$input_string" | md5sum | awk '{print $1}')
-
-        png_file="$rendered_dir/$hash.png"
-        ppm_file="$rendered_dir/$hash.ppm"
-        gif_frame_file=$(printf "$gif_frames_dir/%05d.png" "$i")
-
-        # Render image if it doesn't already exist
-        if [ ! -s "$png_file" ]; then
-            ./bin/Mandelbrot \
-                "$image_width" "$image_height" \
-                "$center_real" "$center_imag" \
-                "$n_max_iter" \
-                "$magn" >"$ppm_file"
-
-            # Convert PPM to PNG and optimize
-            magick "$ppm_file" -format png "$png_file"
-            optipng -o4 -i0 "$png_file" >/dev/null 2>&1
-            advpng -z4 "$png_file" >/dev/null 2>&1
-
-            rm "$ppm_file"
-        fi
-
-        cp "$png_file" "$gif_frame_file"
-        i=$((i + 1))
-    done
-}
-
-generate_gif() {
+render_gif() {
     mkdir -p gifs
     gif_name=$(date '+Mandelbrot-%Y%m%d-%H%M%S').gif
-    echo -e "\n * Generating \t\t \033[32mgif/${gif_name}\033[0m"
-
-    magick -delay 10 -loop 0 "$gif_frames_dir/*.png" gifs/"$gif_name"
 
-    rm -rf $gif_frames_dir
+    # All frames are rendered and encoded by a single process, the GIF palette
+    # comes directly from the color gradient. Tiles computed by earlier runs
+    # are reused from the cache.
+    ./bin/Mandelbrot \
+        "$image_width" "$image_height" \
+        "$center_real" "$center_imag" \
+        "$n_max_iter" \
+        "$target_magn" \
+        --animate --auto-iterations --gain="$magn_gain" --format=gif --delay="$frame_delay" --output=gifs/"$gif_name" \
+        --cache=gifs/.tiles
+
+    echo -e " * Generated \t\t \033[32mgifs/${gif_name}\033[0m"
 }
 
 show_info() {
@@ -111,21 +77,14 @@ show_info() {
     echo -e "Mandbrot set - GIF generation"
     echo -e "   Screen size \t\t ${A_YEL}${image_width}${A_R}x${A_YEL}${image_height}${A_R}"
     echo -e "   Center \t\t (${A_GRE}${center_real}${A_R}, ${A_GRE}${center_imag}${A_R}i)"
-    echo -e "   Max iterations \t ${A_RED}$n_max_iter${A_R}"
+    echo -e "   Max iterations \t Automatic, up to ${A_RED}$n_max_iter${A_R}"
     echo -e "   Magnification \t Target ${A_RED}${target_magn}${A_R}, Gain ${A_RED}${magn_gain}${A_R}"
     echo ""
 }
 
 main() {
     show_info
-    rendered_dir="rendered_images"
-    gif_frames_dir="gif_frames"
-
-    mkdir -p "$rendered_dir"
-    rm -rf "$gif_frames_dir" && mkdir -p "$gif_frames_dir"
-
-    render_mandelbrot_images
-    generate_gif
+    render_gif
 }
 
 case $1 in
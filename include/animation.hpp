@@ -0,0 +1,63 @@
+#ifndef ANIMATION_H
+#define ANIMATION_H
+
+#include "colorizer.hpp"
+#include "gif_encoder.hpp"
+#include "image_writer.hpp"
+#include "options.hpp"
+#include "y4m_writer.hpp"
+
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Destination of an animation: one GIF file, a stream of frames to stdout or
+// a pipe (always for Y4M, otherwise with `--stream`), or a directory with one
+// image per frame. Frames are produced into `rgba()` (or `indices()` for
+// GIF) and handed over with `commit`; encoding runs in the background while
+// the next frame is produced into a second buffer.
+class AnimationOutput {
+  private:
+    ImageFormat _format;
+    uint32_t _width;
+    uint32_t _height;
+    int _level;
+    std::string _destination;
+
+    int _fd = -1;
+    bool _stream = false;
+    std::unique_ptr<GifEncoder> _gif;
+    std::unique_ptr<Y4mWriter> _y4m;
+
+    std::vector<uint8_t> _frames[2];
+    std::vector<uint16_t> _indices;
+    std::future<void> _encoding;
+    size_t _n_frames = 0;
+
+  public:
+    const Coloring coloring;
+
+    AnimationOutput(const Options& options, uint32_t width, uint32_t height, const Coloring& coloring);
+    ~AnimationOutput();
+
+    AnimationOutput(const AnimationOutput&) = delete;
+    AnimationOutput& operator=(const AnimationOutput&) = delete;
+
+    // Whether frames are gradient indices instead of RGBA.
+    bool indexed() const;
+
+    uint8_t* rgba();
+
+    uint16_t* indices();
+
+    // Colors rows of the current frame, `smooth` points to the first value of row `y_start`.
+    void write_rows(const float* smooth, uint32_t y_start, uint32_t y_end);
+
+    void commit();
+
+    void finish();
+};
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef COLORIZER_H
+#define COLORIZER_H
+
+#include "mandelbrot.hpp"
+#include <cstddef>
+#include <cstdint>
+
+// Constants mapping a smooth iteration value onto the cyclic gradient:
+// position = log((smooth - offset) / scale + 1) / log(2) + phase
+struct Coloring {
+    float offset = 1.28f;
+    float scale = 64.0f;
+    float phase = 0.45f;
+};
+
+// Maps smooth iteration values (see `Mandelbrot::smooth`) onto RGBA pixels.
+// Does not depend on any window or graphics context, so it is shared by the
+// interactive viewer, the headless export path and recoloring.
+class Colorizer {
+  public:
+    static constexpr uint8_t RGBA_SIZE = 4; // RGBA color codes have four values
+    static constexpr uint16_t INTERIOR = UINT16_MAX; // Gradient index of points inside the set (black)
+
+    static void colorize(const Mandelbrot& mandelbrot, uint8_t* pixels, const Coloring& coloring = Coloring());
+
+    // Colors `count` smooth values into `pixels[0..4 * count)`.
+    static void colorize(const float* smooth, uint8_t* pixels, size_t count, const Coloring& coloring = Coloring());
+
+    // Same as `colorize`, but stores the position in the color gradient
+    // instead of the color itself, e.g. for palette based formats.
+    static void gradient_indices(const float* smooth, uint16_t* indices, size_t count,
+                                 const Coloring& coloring = Coloring());
+
+    static uint16_t gradient_index(float smooth, const Coloring& coloring = Coloring());
+
+    // Colors `count` values in [0, 1] on a black, red, yellow, white heat
+    // scale, e.g. the cost of pixels.
+    static void heatmap(const float* heat, uint8_t* pixels, size_t count);
+
+    static uint16_t gradient_length();
+
+    // RGB color of a gradient index, `index` must not be `INTERIOR`.
+    static const uint8_t* gradient_color(uint16_t index);
+};
+
+#endif
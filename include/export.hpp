@@ -0,0 +1,20 @@
+#ifndef EXPORT_H
+#define EXPORT_H
+
+#include "options.hpp"
+
+// Renders a single frame and streams it to stdout.
+// Positional: width height real imag n_iter_max magnification
+void export_frame(const Options& options);
+
+// Renders a whole zoom sequence in one process, from magnification 1 up to
+// the target magnification, and writes the frames into a directory.
+// Positional: width height real imag n_iter_max target_magnification
+void export_animation(const Options& options);
+
+// Colors an iteration map written with `--format=itmap` and streams the image
+// to stdout, without computing anything.
+// Option: --recolor=path
+void recolor(const Options& options);
+
+#endif
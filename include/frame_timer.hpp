@@ -0,0 +1,94 @@
+#ifndef FRAME_TIMER_H
+#define FRAME_TIMER_H
+
+#include "perf_counters.hpp"
+#include "trace.hpp"
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+// Time spent in the stages of the interactive loop, kept for the last
+// `CAPACITY` frames. Time is attributed to the innermost `Scope` only, e.g.
+// rows colored from within the computation do not count as compute, although
+// the workers keep computing meanwhile (their busy time is in
+// `Mandelbrot::worker_stats`). Scopes also appear as spans in the `Trace`.
+class FrameTimer {
+  public:
+    enum class Stage : uint32_t {
+        EVENTS,
+        COMPUTE,
+        COLOR,
+        UPLOAD,
+        PRESENT,
+    };
+
+    static constexpr size_t N_STAGES = 5;
+    static constexpr size_t CAPACITY = 1024;
+
+    class Scope {
+      private:
+        FrameTimer& _timer;
+        int _previous;
+        Trace::Span _span;
+
+      public:
+        Scope(FrameTimer& timer, Stage stage);
+        ~Scope();
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+    };
+
+  private:
+    using Clock = std::chrono::steady_clock;
+    using Sample = std::array<double, N_STAGES>; // Seconds, NaN if the stage did not run
+
+    std::vector<Sample> _frames;
+    size_t _next = 0;
+    Sample _current;
+    Sample _last;
+
+    int _stage = -1;
+    Clock::time_point _since;
+
+    // Optional hardware counters summed over the whole session. The main
+    // thread's are attributed like the time, those of all other threads (the
+    // workers) to COMPUTE, as they keep computing during nested stages.
+    const PerfCounters* _counters = nullptr;
+    const PerfCounters* _main_counters = nullptr;
+    uint64_t _pixels_per_frame = 0;
+    PerfCounters::Values _counters_since;
+    PerfCounters::Values _main_counters_since;
+    std::array<PerfCounters::Values, N_STAGES> _counter_totals = {};
+    std::array<uint64_t, N_STAGES> _runs = {};
+
+    int _switch(int stage);
+
+  public:
+    FrameTimer();
+
+    // Attributes `counters` (of the process) to the stages from now on, with
+    // `main_counters` counting the thread which runs the stages. The report
+    // relates them to `pixels_per_frame` for every frame a stage ran in.
+    void set_counters(const PerfCounters* counters, const PerfCounters* main_counters, uint64_t pixels_per_frame);
+
+    // Stores the current frame in the ring buffer and starts the next one.
+    void end_frame();
+
+    // Seconds of the most recent frame in which `stage` ran.
+    double last(Stage stage) const;
+
+    // Percentile `p` in [0, 1] of `stage` over the stored frames it ran in.
+    double percentile(Stage stage, double p) const;
+
+    // Table of p50/p95/p99 per stage, and of IPC and misses per pixel with
+    // counters.
+    void report(std::ostream& out) const;
+
+    static const char* stage_name(Stage stage);
+};
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef GIF_ENCODER_H
+#define GIF_ENCODER_H
+
+#include "thread_pool.hpp"
+
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <string>
+#include <vector>
+
+// Writes an animated GIF from gradient indices (see `Colorizer::gradient_indices`).
+// All colors come from the fixed gradient, so no color quantization is
+// needed: the palette is derived directly from the gradient, either once for
+// the whole animation or per frame from the indices actually in use.
+//
+// Pixels which look the same as in the previous frame become transparent and
+// each frame is cropped to the changed area. The LZW compression of a frame
+// runs on the thread pool, frames are written in order.
+class GifEncoder {
+  public:
+    enum class Palette {
+        GLOBAL, // Gradient sampled evenly, shared by all frames
+        FRAME,  // Gradient sampled by usage, one local palette per frame
+    };
+
+  private:
+    // Palette entry 0 is transparent, 1 is the interior (black).
+    static constexpr uint8_t TRANSPARENT = 0;
+    static constexpr uint8_t INTERIOR = 1;
+    static constexpr uint16_t N_GRADIENT_COLORS = 254;
+
+    int _fd;
+    uint32_t _width;
+    uint32_t _height;
+    uint16_t _delay;
+    Palette _palette_mode;
+    ThreadPool& _pool;
+
+    std::vector<uint8_t> _global_palette;
+    std::vector<uint32_t> _displayed; // RGB currently visible per pixel
+    std::deque<std::future<std::vector<uint8_t>>> _pending;
+    bool _first_frame = true;
+
+    std::vector<uint8_t> _build_palette(const uint16_t* indices, std::vector<uint8_t>& lookup) const;
+
+    void _write_ready(size_t max_pending);
+
+  public:
+    // `delay` is the time between frames in 1/100 s.
+    GifEncoder(int fd, uint32_t width, uint32_t height, uint16_t delay, Palette palette,
+               ThreadPool& pool = ThreadPool::shared());
+
+    GifEncoder(const GifEncoder&) = delete;
+    GifEncoder& operator=(const GifEncoder&) = delete;
+
+    void add_frame(const uint16_t* indices);
+
+    // Writes all pending frames and the trailer.
+    void finish();
+
+    // "global" or "frame"
+    static Palette parse_palette(const std::string& name);
+
+    static std::vector<uint8_t> lzw_compress(const std::vector<uint8_t>& pixels);
+};
+
+#endif
@@ -0,0 +1,66 @@
+#ifndef IMAGE_WRITER_H
+#define IMAGE_WRITER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "tiff_writer.hpp"
+
+enum class ImageFormat {
+    P3,   // ASCII PPM, kept for compatibility
+    P6,   // Binary PPM
+    RGBA, // Raw 8 bit RGBA, no header
+    PNG,  // Needs the whole frame, see `PngEncoder`
+    GIF,  // Palette based, see `GifEncoder`
+    TIFF, // Tiled BigTIFF, see `TiffWriter`
+    Y4M,  // YUV4MPEG2 video stream, see `Y4mWriter`
+};
+
+ImageFormat parse_image_format(const std::string& name);
+
+std::string image_extension(ImageFormat format);
+
+// Writes all of `data` to `fd`, retrying on short writes.
+void write_all(int fd, const uint8_t* data, size_t size);
+
+// Creates or truncates `path` for writing.
+int open_output_file(const std::string& path);
+
+// Writes a whole RGBA frame in any format but GIF. `level` is the PNG compression level,
+// Y4M is written as a stream of a single frame.
+void write_image(int fd, ImageFormat format, uint32_t width, uint32_t height, const uint8_t* rgba, int level);
+
+void write_image_file(const std::string& path, ImageFormat format, uint32_t width, uint32_t height,
+                      const uint8_t* rgba, int level);
+
+// Streams RGBA rows to a file descriptor in the given format. Rows are
+// converted into an internal buffer which is handed to `write` in large
+// blocks, so the image never needs to be held in memory as a whole.
+class ImageWriter {
+  private:
+    static constexpr size_t BUFFER_SIZE = 1U << 20;
+
+    int _fd;
+    ImageFormat _format;
+    uint32_t _width;
+    std::vector<uint8_t> _buffer;
+    std::unique_ptr<TiffWriter> _tiff;
+
+    void _put(const void* data, size_t size);
+
+  public:
+    ImageWriter(int fd, ImageFormat format, uint32_t width, uint32_t height);
+    ~ImageWriter();
+
+    ImageWriter(const ImageWriter&) = delete;
+    ImageWriter& operator=(const ImageWriter&) = delete;
+
+    void write_rows(const uint8_t* rgba, uint32_t n_rows);
+
+    void flush();
+};
+
+#endif
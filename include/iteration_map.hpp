@@ -0,0 +1,74 @@
+#ifndef ITERATION_MAP_H
+#define ITERATION_MAP_H
+
+#include "mandelbrot.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// On-disk layout of an iteration map: this header, followed by the smooth
+// iteration values (float, native byte order) of all pixels in tile order.
+// Tiles are `tile_size` x `tile_size`, stored row by row; edge tiles are
+// padded with `Mandelbrot::INTERIOR`. Viewport values are stored as decimal
+// strings, so they keep the precision they were rendered with.
+struct IterationMapHeader {
+    char magic[8]; // "MBITMAP1"
+    uint32_t width;
+    uint32_t height;
+    uint32_t tile_size;
+    uint32_t n_iter_max;
+    uint32_t precision_bits; // Mantissa bits of the kernel the map was computed with
+    uint32_t reserved;
+    char center_real[80];
+    char center_imag[80];
+    char magnification[64];
+};
+
+static_assert(sizeof(IterationMapHeader) == 256, "Header size is part of the file format");
+
+// Streams the iteration map of a frame to a file descriptor while the rows
+// arrive in order, buffering only one row of tiles.
+class IterationMapWriter {
+  private:
+    int _fd;
+    IterationMapHeader _header;
+    std::vector<float> _tile_rows;
+    uint32_t _rows_buffered = 0;
+
+    void _write_tile_row();
+
+  public:
+    static constexpr uint32_t TILE_SIZE = 64U;
+
+    // `precision_bits` is only recorded in the header, 0 records the mantissa
+    // bits of `mandelbrot.kernel`.
+    IterationMapWriter(int fd, const Mandelbrot& mandelbrot, uint32_t precision_bits = 0);
+
+    // `smooth` points to the first value of row `y_start`.
+    void write_rows(const float* smooth, uint32_t y_start, uint32_t y_end);
+};
+
+// Read-only, memory-mapped view of an iteration map file.
+class IterationMap {
+  private:
+    void* _mapping = nullptr;
+    size_t _size = 0;
+    const float* _values = nullptr;
+    uint32_t _tiles_x = 0;
+
+  public:
+    const IterationMapHeader* header = nullptr;
+
+    explicit IterationMap(const std::string& path);
+    ~IterationMap();
+
+    IterationMap(const IterationMap&) = delete;
+    IterationMap& operator=(const IterationMap&) = delete;
+
+    // Copies rows [y_start, y_end) into `out` in row-major order.
+    void read_rows(uint32_t y_start, uint32_t y_end, float* out) const;
+};
+
+#endif
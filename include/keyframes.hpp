@@ -0,0 +1,48 @@
+#ifndef KEYFRAMES_H
+#define KEYFRAMES_H
+
+#include "animation.hpp"
+#include "mandelbrot.hpp"
+#include "thread_pool.hpp"
+
+#include <cstdint>
+#include <vector>
+
+// Zoom animation from keyframes, the way Kalles Fraktaler zoom videos are
+// made. Only keyframes at magnifications target / 2^k are computed, each
+// oversized by `oversample`. Every frame in between is resampled from the two
+// keyframes enclosing its magnification, taking the inner (more detailed)
+// keyframe wherever it covers the frame.
+class KeyframeZoom {
+  private:
+    struct Keyframe {
+        long double magnification = 0.0L;
+        std::vector<uint8_t> rgba;
+        std::vector<uint16_t> indices;
+    };
+
+    const uint32_t _width;
+    const uint32_t _height;
+    ThreadPool& _pool;
+    Mandelbrot _engine;
+
+    void _render_keyframe(Keyframe& keyframe, long double magnification, AnimationOutput& output);
+
+    void _synthesize(const Keyframe& outer, const Keyframe* inner, long double magnification,
+                     AnimationOutput& output);
+
+  public:
+    Mandelbrot::Kernel kernel = Mandelbrot::Kernel::DIRECT;
+
+    // See `Mandelbrot::auto_iterations`, chosen per keyframe and never lower
+    // than for the previous one.
+    uint32_t auto_iterations = 0;
+
+    KeyframeZoom(uint32_t width, uint32_t height, const Complex& center, uint32_t n_iter_max, float oversample,
+                 ThreadPool& pool = ThreadPool::shared());
+
+    // Produces one frame per entry of `steps` (ascending magnifications).
+    void render(const std::vector<long double>& steps, AnimationOutput& output);
+};
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef LOGPOLAR_H
+#define LOGPOLAR_H
+
+#include "animation.hpp"
+#include "mandelbrot.hpp"
+#include "thread_pool.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Zoom animation from a single log-polar strip around the center (exponential
+// map). Each row of the strip is a ring at an exponentially shrinking radius,
+// so the strip covers the whole zoom from the first to the last frame, and
+// every frame is reconstructed from it by a cheap warp. For deep zooms this
+// replaces N full frames with a strip whose height grows with the logarithm
+// of the zoom, computed in blocks of rows if it exceeds the memory budget.
+class LogPolarZoom {
+  private:
+    const uint32_t _width;
+    const uint32_t _height;
+    ThreadPool& _pool;
+
+    Complex _center;
+    uint32_t _n_iter_max;
+    uint32_t _strip_width;
+
+    // `rgba` or `indices` hold the strip from `first_row` on.
+    void _warp(const std::vector<uint8_t>& rgba, const std::vector<uint16_t>& indices, size_t first_row,
+               uint32_t strip_height, long double radius, long double magnification, AnimationOutput& output);
+
+  public:
+    Mandelbrot::Kernel kernel = Mandelbrot::Kernel::DIRECT;
+
+    // Budget in bytes for the strip, which is computed in blocks of rows if
+    // it does not fit.
+    size_t memory = size_t(1024) << 20;
+
+    // `strip_width == 0` picks the number of angles from the frame size.
+    LogPolarZoom(uint32_t width, uint32_t height, const Complex& center, uint32_t n_iter_max, uint32_t strip_width,
+                 ThreadPool& pool = ThreadPool::shared());
+
+    // Produces one frame per entry of `steps` (ascending magnifications).
+    void render(const std::vector<long double>& steps, AnimationOutput& output);
+};
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef LRU_TILE_CACHE_H
+#define LRU_TILE_CACHE_H
+
+#include "tile_cache.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+// In-memory tile cache with least recently used eviction under a memory
+// budget. Tiles are addressed by zoom level (their exact pixel size) and grid
+// coordinates. With power-of-two zoom steps the levels form a quadtree: tile
+// (x, y) covers the area of tiles (2x, 2y) to (2x + 1, 2y + 1) one level
+// deeper. Misses fall through to `next` (e.g. the persistent `TileCache`) and
+// new tiles are passed on to it.
+class LruTileCache : public TileStore {
+  private:
+    struct Entry {
+        TileKey key;
+        std::array<uint8_t, TILE_BYTES> data;
+    };
+
+    struct KeyHash {
+        size_t operator()(const TileKey& key) const;
+    };
+
+    struct KeyEqual {
+        bool operator()(const TileKey& a, const TileKey& b) const;
+    };
+
+    TileStore* _next;
+    size_t _max_tiles;
+
+    std::mutex _mutex;
+    std::list<Entry> _entries; // Most recently used first
+    std::unordered_map<TileKey, std::list<Entry>::iterator, KeyHash, KeyEqual> _index;
+
+    void _store(const TileKey& key, const uint32_t* iterations, const float* smooth);
+
+  public:
+    LruTileCache(size_t budget, TileStore* next = nullptr);
+
+    bool lookup(const TileKey& key, uint32_t* iterations, float* smooth) override;
+
+    void insert(const TileKey& key, const uint32_t* iterations, const float* smooth) override;
+};
+
+#endif
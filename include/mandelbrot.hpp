@@ -1,76 +1,311 @@
 #ifndef MANDELBROT_H
 #define MANDELBROT_H
 
-#include <SFML/Graphics.hpp>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <gmpxx.h>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
 
-// std::complex not needed for such simple calculations.
-// TODO Maybe faster?
+#include "thread_pool.hpp"
+
+class PreviewPyramid;
+struct ReferenceOrbit;
+class TileStore;
+
+// Center coordinates in arbitrary precision, deep zooms need far more digits
+// than long double has. std::complex not needed for such simple calculations.
 struct Complex {
-    long double real;
-    long double imag;
+    mpf_class real;
+    mpf_class imag;
+
+    Complex() = default;
+    Complex(mpf_class real, mpf_class imag) : real(std::move(real)), imag(std::move(imag)) {}
+    Complex(const Complex&) = default;
+    Complex(Complex&&) = default;
+
+    // Unlike for mpf_class, the copy takes the precision of `other` along.
+    Complex& operator=(const Complex& other);
+    Complex& operator=(Complex&&) = default;
 };
 
-const long double PRESETS[22][2] = {
-    {+0.382308869L, -0.3895870170L},
-    {+0.288935044L, -0.0123748250L},
-    {+0.286016756L, +0.0115598130L},
-    {+0.276643312L, +0.0091976760L},
-    {+0.235336955L, -0.5152623050L},
-    {+0.115116634L, +0.6278655140L},
-    {+0.438204695L, +0.3420529940L},
-    {-0.028375015L, +0.6946544980L},
-    {-0.106750445L, +0.8828258480L},
-    {-0.673281229L, +0.3600723860L},
-    {-0.743643887037158704752191506114774L, +0.131825904205311970493132056385139L},
-    {-1.009078747L, +0.3108562000L},
-    {-1.167468173L, -0.2461746550L},
-    {-1.167468173L, -0.2461746550L},
-    {-1.168235004L, -0.2462116668L},
-    {-1.168235004L, -0.2462116668L},
-    {-1.394420575L, -0.0018272120L},
-    {-1.394420575L, -0.0018272120L},
-    {-1.403445777L, +0.0000000120L},
-    {-1.768778829L, +0.0017389240L},
-    {-1.940157353L, +0.0000000000L},
+// Parses a decimal coordinate, keeping all of its digits.
+mpf_class parse_coordinate(const std::string& text);
+
+// Decimal representation with `digits` significant digits.
+std::string format_coordinate(const mpf_class& value, int digits);
+
+long double to_long_double(const mpf_class& value);
+
+// Decimal strings, so that deep locations keep all of their digits.
+const char* const PRESETS[22][2] = {
+    {"+0.382308869", "-0.3895870170"},
+    {"+0.288935044", "-0.0123748250"},
+    {"+0.286016756", "+0.0115598130"},
+    {"+0.276643312", "+0.0091976760"},
+    {"+0.235336955", "-0.5152623050"},
+    {"+0.115116634", "+0.6278655140"},
+    {"+0.438204695", "+0.3420529940"},
+    {"-0.028375015", "+0.6946544980"},
+    {"-0.106750445", "+0.8828258480"},
+    {"-0.673281229", "+0.3600723860"},
+    {"-0.743643887037158704752191506114774", "+0.131825904205311970493132056385139"},
+    {"-1.009078747", "+0.3108562000"},
+    {"-1.167468173", "-0.2461746550"},
+    {"-1.167468173", "-0.2461746550"},
+    {"-1.168235004", "-0.2462116668"},
+    {"-1.168235004", "-0.2462116668"},
+    {"-1.394420575", "-0.0018272120"},
+    {"-1.394420575", "-0.0018272120"},
+    {"-1.403445777", "+0.0000000120"},
+    {"-1.768778829", "+0.0017389240"},
+    {"-1.940157353", "+0.0000000000"},
+    {"+0.0", "+0.0"},
 };
 
 class Mandelbrot {
   public:
+    // Rows are handed out to the workers in bands of this height. Small enough
+    // to balance the load, large enough to keep the scheduling overhead low.
+    static constexpr uint32_t BAND_HEIGHT = 8U;
+
+    // Bands are computed in tiles of this width, see `tile_time`.
+    static constexpr uint32_t TILE_WIDTH = 64U;
+
+    // The automatic iteration limit is chosen on a preview this many times
+    // smaller in both directions.
+    static constexpr uint32_t PROBE_SCALE = 8U;
+
+    // Escape radius squared, large values give smoother coloring.
+    static constexpr long double BAILOUT = 128.0L;
+
+    // How a pixel is iterated. DIRECT uses long double for every pixel.
+    // PERTURBATION iterates the center once (see `ReferenceOrbit`) and every
+    // pixel as a double precision delta to it, rebasing to the start of the
+    // reference when the delta grows larger than the orbit. The values also
+    // identify the kernel in cache keys, as results of the kernels differ.
+    enum class Kernel : uint32_t {
+        DIRECT = 1,
+        PERTURBATION = 2,
+    };
+
+    // Smooth iteration value of points which did not escape.
+    static constexpr float INTERIOR = -1.0f;
+
+    // What one worker of the pool did during the last `update`.
+    struct WorkerStats {
+        uint64_t pixels = 0;     // Pixels of the view it produced
+        uint64_t iterations = 0; // Iterations it executed, tiles from a cache add none
+        double busy_time = 0.0;  // Seconds spent on bands
+        double idle_time = 0.0;  // Seconds of `frame_time` spent otherwise
+
+        double iteration_rate() const { return busy_time > 0.0 ? iterations / busy_time : 0.0; }
+    };
+
+    // Escape statistics of the pixels of a frame. Every worker reduces the
+    // pixels it produces into its own, they are merged at the end of `update`.
+    struct FrameStats {
+        static constexpr uint32_t HISTOGRAM_BINS = 64;
+
+        uint32_t n_iter_max = 0;
+        uint32_t bin_shift = 0; // Smallest one which fits n_iter_max - 1 into the bins
+        uint64_t pixels = 0;
+        uint64_t escaped = 0;                 // The others hit `n_iter_max`
+        uint64_t escaped_iterations = 0;      // Sum over the escaped pixels
+        uint32_t min_iterations = UINT32_MAX; // Of the escaped pixels
+        uint32_t max_iterations = 0;
+
+        // Escaped pixels by iterations, bin i holds [i << bin_shift, (i + 1) << bin_shift).
+        std::array<uint64_t, HISTOGRAM_BINS> histogram = {};
+
+        explicit FrameStats(uint32_t n_iter_max = 0);
+
+        void add(uint32_t n_iter, float value) {
+            pixels++;
+            if (value == INTERIOR)
+                return;
+            escaped++;
+            escaped_iterations += n_iter;
+            min_iterations = std::min(min_iterations, n_iter);
+            max_iterations = std::max(max_iterations, n_iter);
+            histogram[std::min(n_iter >> bin_shift, HISTOGRAM_BINS - 1)]++;
+        }
+
+        void merge(const FrameStats& other);
+
+        uint64_t interior() const { return pixels - escaped; }
+
+        double escape_ratio() const { return pixels > 0 ? double(escaped) / pixels : 0.0; }
+
+        double mean_iterations() const { return escaped > 0 ? double(escaped_iterations) / escaped : 0.0; }
+    };
+
     const uint32_t width;
     const uint32_t height;
 
     long double zoom_factor = 2L;
     uint32_t n_iter_max = 128U;
 
+    // If not 0, `update` chooses `n_iter_max` for every frame itself, at most
+    // this many, see `choose_iterations`.
+    uint32_t auto_iterations = 0;
+
     int region_index = 0;
-    Complex center_point = {PRESETS[region_index][0], PRESETS[region_index][1]};
+    Complex center_point = {parse_coordinate(PRESETS[region_index][0]), parse_coordinate(PRESETS[region_index][1])};
 
     long double magnification = 1.0L;
 
+    Kernel kernel = Kernel::DIRECT;
+
+    // The buffers hold rows [row_offset, row_offset + height) of a frame with
+    // `frame_height` rows. Used to render images larger than memory in strips.
+    uint32_t frame_height;
+    uint32_t row_offset = 0;
+
+    // Log-polar sampling around the center instead of a rectangular view:
+    // column x is the angle 2 pi x / width, row y the radius
+    // polar_radius * exp(-2 pi y / width), so pixels stay square.
+    bool log_polar = false;
+    long double polar_radius = 2.0L;
+
+    // Optional tile cache. With a cache the view is snapped to a global pixel
+    // grid of its pixel size, so tiles can be reused across frames.
+    TileStore* tile_cache = nullptr;
+
+    // Optional preview, every finished frame is stored in it.
+    PreviewPyramid* preview = nullptr;
+
   private:
-    long double _real_start;
-    long double _imag_start;
+    ThreadPool& _pool;
+
+    // Offset of the first pixel from the center and between pixels. All
+    // pixels are computed as offsets from the center, which keeps them exact
+    // no matter how many digits the center has.
+    long double _offset_real;
+    long double _offset_imag;
     long double _delta_real;
     long double _delta_imag;
 
+    // Parameters of the frame being computed. The public ones may change
+    // while `update` runs, e.g. from `on_rows`, and only apply to the next frame.
+    Complex _center;
+    long double _center_real; // Approximations of `_center` for the direct kernel
+    long double _center_imag;
+    long double _magnification;
+    uint32_t _n_iter_max;
+    Kernel _kernel;
+    std::shared_ptr<const ReferenceOrbit> _orbit;
+    std::atomic<bool> _cancelled = false;
+
+    // Grid position of the first pixel and the row where the first full band
+    // starts, both zero without a tile cache.
+    int64_t _origin_x = 0;
+    int64_t _origin_y = 0;
+    uint32_t _band_phase = 0;
+
+    std::vector<WorkerStats> _worker_stats;
+    FrameStats _frame_stats;
+
+    // Seconds per tile of the last frame, band by band. Tile columns start at
+    // `_tile_x0`, which is negative if a cached tile sticks out on the left.
+    std::vector<float> _tile_times;
+    int64_t _tile_x0 = 0;
+    uint32_t _n_tile_columns = 0;
+
   public:
     bool has_changed = true;
-    double frame_time;
 
-    long double* real_parts;
-    long double* imag_parts;
+    // Wall time of the last `update` in seconds, including `on_rows`.
+    double frame_time = 0.0;
+
+    // Per pixel: number of iterations and the smooth (continuous) iteration
+    // count n + (log(log(bailout)) - log(log|z|)) / log(2), see `Colorizer`.
     uint32_t* iterations;
+    float* smooth;
 
   public:
-    Mandelbrot(const uint32_t width, const uint32_t height);
+    Mandelbrot(const uint32_t width, const uint32_t height, ThreadPool& pool = ThreadPool::shared());
+    ~Mandelbrot();
+
+    Mandelbrot(const Mandelbrot&) = delete;
+    Mandelbrot& operator=(const Mandelbrot&) = delete;
 
     void update();
 
-    void _base_algorithm(uint32_t x, uint32_t y);
+    // Same as `update`, but calls `on_rows(y_start, y_end)` on the calling
+    // thread, in order, as soon as consecutive rows are finished.
+    void update(const std::function<void(uint32_t y_start, uint32_t y_end)>& on_rows);
+
+    // Stops the running `update` after the bands in progress, e.g. from
+    // `on_rows` or another thread when the view changed. The frame stays incomplete and
+    // `has_changed` is set again.
+    void cancel();
+
+    // One entry per worker of the pool, for the last `update`.
+    const std::vector<WorkerStats>& worker_stats() const;
+
+    // Maximum over mean busy time of the workers in the last `update`, 1 if
+    // the work was spread perfectly.
+    double imbalance() const;
+
+    // Of the pixels computed or taken from the cache in the last `update`,
+    // all of them unless it was cancelled.
+    const FrameStats& frame_stats() const;
 
-    void _calculate_chunk(uint32_t y_start, uint32_t y_end);
+    // Wall time in seconds spent on the tile which contains pixel (x, y) in
+    // the last `update`. Tiles are TILE_WIDTH pixels wide and a band high,
+    // with a tile cache they are the cached tiles and a hit costs the lookup.
+    double tile_time(uint32_t x, uint32_t y) const;
+
+    // These return the number of iterations executed and add the pixels to `stats`.
+    uint32_t _base_algorithm(uint32_t x, uint32_t y, FrameStats& stats);
+
+    uint64_t _calculate_chunk(uint32_t y_start, uint32_t y_end, FrameStats& stats);
+
+    uint64_t _calculate_tiles(uint32_t y_start, uint32_t y_end, FrameStats& stats);
+
+    // Iterates the point at offset (`dc_real`, `dc_imag`) from the center.
+    float _escape_time(long double dc_real, long double dc_imag, uint32_t& n_iter) const;
+
+    float _direct_escape_time(long double c_real, long double c_imag, uint32_t& n_iter) const;
+
+    float _perturbed_escape_time(double dc_real, double dc_imag, uint32_t& n_iter) const;
 
     void change_region(const int increment);
+
+    // Moves the center by (`real`, `imag`) / magnification, with the precision
+    // the current magnification needs.
+    void move(long double real, long double imag);
+
+    // Raises the precision of `center_point` to what `magnification` needs.
+    // Zooms call it with their deepest magnification, so all frames share one
+    // reference orbit.
+    void reserve_precision(long double magnification);
+
+    // Iteration limit for the current view, between `minimum_iterations` (or
+    // `min_iterations` if larger) and `max_iterations`. The view is computed at 1 / PROBE_SCALE of the size,
+    // and the limit doubled as long as more than 0.1 % of the pixels are at
+    // the limit (outside of the main cardioid and bulb), and escapes are
+    // still slow: more than 0.1 % of the pixels or 1 % of the escaped ones
+    // need over half of the limit, or none escape yet. Then a higher limit
+    // would still let boundary pixels escape.
+    uint32_t choose_iterations(uint32_t max_iterations, uint32_t min_iterations = 0);
+
+    // Power of two that grows with the number of octaves of `magnification`.
+    static uint32_t minimum_iterations(long double magnification);
+
+    // Mantissa bits the center needs at `magnification` for a view `width`
+    // pixels wide, in steps of 64 bits.
+    static mp_bitcnt_t precision_bits(long double magnification, uint32_t width);
+
+    static float smooth_iteration(uint32_t n_iter, long double z_real, long double z_imag);
+
+    static Kernel parse_kernel(const std::string& name);
 };
 
-#endif
\ No newline at end of file
+#endif
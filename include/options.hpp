@@ -0,0 +1,25 @@
+#ifndef OPTIONS_H
+#define OPTIONS_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+// Minimal command line parsing. Arguments of the form `--name=value` or
+// `--name` are options, everything else is positional. Options always use `=`,
+// so negative numbers like `-0.5` stay positional.
+class Options {
+  private:
+    std::map<std::string, std::string> _values;
+
+  public:
+    std::vector<std::string> positional;
+
+    Options(int argc, char* argv[]);
+
+    bool has(const std::string& name) const;
+
+    std::string get(const std::string& name, const std::string& fallback) const;
+};
+
+#endif
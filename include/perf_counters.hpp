@@ -0,0 +1,54 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// Hardware counters from Linux perf_event_open, counted in user space only.
+// PROCESS includes the threads started after the construction, so it has to
+// be created before the thread pool. THREAD counts only the thread that
+// constructs it. Counters the CPU, kernel or permissions
+// (kernel.perf_event_paranoid) do not provide read as 0.
+class PerfCounters {
+  public:
+    enum class Target : uint32_t {
+        PROCESS,
+        THREAD,
+    };
+
+    enum class Counter : uint32_t {
+        CYCLES,
+        INSTRUCTIONS,
+        CACHE_MISSES,
+        BRANCH_MISSES,
+        RAW, // CPU specific, e.g. 0x1eca for FP_ASSIST.ANY (x87/FP assists) on Intel
+    };
+
+    static constexpr size_t N_COUNTERS = 5;
+
+    using Values = std::array<uint64_t, N_COUNTERS>;
+
+  private:
+    std::array<int, N_COUNTERS> _fds;
+    Target _target;
+
+    void _open(Counter counter, uint32_t type, uint64_t config);
+
+  public:
+    // `raw_event` is the config of the RAW counter, 0 leaves it disabled.
+    explicit PerfCounters(uint64_t raw_event = 0, Target target = Target::PROCESS);
+    ~PerfCounters();
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    bool available(Counter counter) const;
+
+    // Counts since the construction, scaled if the kernel had to multiplex.
+    Values read() const;
+
+    static const char* name(Counter counter);
+};
+
+#endif
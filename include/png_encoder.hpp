@@ -0,0 +1,24 @@
+#ifndef PNG_ENCODER_H
+#define PNG_ENCODER_H
+
+#include "thread_pool.hpp"
+
+#include <cstdint>
+#include <vector>
+
+// Encodes RGBA pixels as an 8 bit RGB PNG. The filtered scanlines are split
+// into chunks which are deflated independently on the thread pool and then
+// concatenated into a single zlib stream (the same approach as pigz). Each
+// chunk is primed with the tail of its predecessor as dictionary, so the
+// compression ratio stays close to a single-threaded encode.
+class PngEncoder {
+  public:
+    // Uncompressed bytes per deflate chunk.
+    static constexpr size_t CHUNK_SIZE = 256U << 10;
+
+    // `level` is the zlib compression level from 0 (store) to 9 (smallest).
+    static std::vector<uint8_t> encode(const uint8_t* rgba, uint32_t width, uint32_t height, int level,
+                                       ThreadPool& pool = ThreadPool::shared());
+};
+
+#endif
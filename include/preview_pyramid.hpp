@@ -0,0 +1,37 @@
+#ifndef PREVIEW_PYRAMID_H
+#define PREVIEW_PYRAMID_H
+
+#include "mandelbrot.hpp"
+
+#include <cstdint>
+#include <vector>
+
+// Mip pyramid of the smooth iteration values of the last finished frame.
+// A new view can be resampled from it immediately, which gives a provisional
+// image until the exact rows are computed. Zooming out samples a coarser
+// level, so the preview does not alias.
+class PreviewPyramid {
+  private:
+    static constexpr uint32_t MAX_LEVELS = 8U;
+
+    struct Level {
+        uint32_t width;
+        uint32_t height;
+        std::vector<float> smooth;
+    };
+
+    std::vector<Level> _levels;
+    Complex _center;
+    long double _pixel_size;
+
+  public:
+    // Stores a frame of `width` x `height` values, rendered with `center` and `magnification`.
+    void store(const float* smooth, uint32_t width, uint32_t height, const Complex& center, long double magnification);
+
+    // Fills `out` with the view given by `center` and `magnification`, parts
+    // outside the stored frame are `Mandelbrot::INTERIOR`. Returns false if
+    // nothing is stored yet.
+    bool resample(const Complex& center, long double magnification, uint32_t width, uint32_t height, float* out) const;
+};
+
+#endif
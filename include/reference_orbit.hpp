@@ -0,0 +1,55 @@
+#ifndef REFERENCE_ORBIT_H
+#define REFERENCE_ORBIT_H
+
+#include "mandelbrot.hpp"
+
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Orbit Z_0 = 0, Z_1, ... of the view center, up to its escape or
+// `n_iter_max`. The perturbation kernel iterates every pixel as a small
+// delta to it in double precision. It only depends on the center and the
+// iteration limit, so it is shared by all frames of a zoom.
+struct ReferenceOrbit {
+    std::vector<double> real;
+    std::vector<double> imag;
+    mp_bitcnt_t precision = 0; // It was iterated with
+
+    // Iterates with `precision` mantissa bits, the result is rounded to double.
+    static ReferenceOrbit compute(const Complex& center, uint32_t n_iter_max, mp_bitcnt_t precision);
+};
+
+// Reference orbits by center and iteration limit, kept in memory and, with a
+// directory set, on disk, so they are reused across sessions and processes.
+// An orbit serves all requests up to the precision it was computed with.
+class OrbitCache {
+  private:
+    static constexpr size_t MAX_ORBITS = 64;
+
+    std::mutex _mutex;
+    std::string _directory;
+    std::map<std::string, std::shared_ptr<const ReferenceOrbit>> _orbits;
+    std::deque<std::string> _order; // Oldest first
+
+    // Null unless the file holds the orbit of `key` with at least `precision`.
+    std::shared_ptr<const ReferenceOrbit> _load(const std::string& path, const std::string& key,
+                                                mp_bitcnt_t precision);
+
+    void _save(const std::string& path, const std::string& key, const ReferenceOrbit& orbit);
+
+  public:
+    // Stores orbits as files in `directory`, which is created if needed.
+    void set_directory(const std::string& directory);
+
+    std::shared_ptr<const ReferenceOrbit> get(const Complex& center, uint32_t n_iter_max, mp_bitcnt_t precision);
+
+    // Cache used by all engines, memory only until `set_directory` is called.
+    static OrbitCache& shared();
+};
+
+#endif
@@ -1,20 +1,41 @@
 #ifndef RENDERER_H
 #define RENDERER_H
 
-#include "mandelbrot.hpp"
+#include "frame_timer.hpp"
 #include "mandelbrot.hpp"
 #include <SFML/Graphics.hpp>
+#include <vector>
 
 class Renderer {
   private:
+    // What the info bar shows, cycled with T.
+    enum class InfoMode {
+        VIEW,
+        TIMING,
+        WORKERS,
+        STATISTICS,
+    };
+
+    // What the image shows, cycled with C: the colored set, or the cost of
+    // the last computation per pixel or per tile as a heatmap.
+    enum class HeatMode {
+        OFF,
+        ITERATIONS,
+        TILE_TIME,
+    };
+
     uint32_t screen_width;
     uint32_t screen_height;
     double zoom_factor = 2.0;
+    InfoMode info_mode = InfoMode::VIEW;
+    HeatMode heat_mode = HeatMode::OFF;
+
+    std::vector<float> heat;
+    double max_tile_time = 0.0; // Of the rows colored since the first one
 
     sf::Texture screen_texture;
     sf::Sprite screen_sprite;
 
-    sf::Clock clock;
     sf::Text info_text;
     sf::RectangleShape info_text_box;
     sf::Font font;
@@ -23,16 +44,28 @@ class Renderer {
 
     void _key_press_mappings(sf::Event& event, sf::RenderWindow& window, Mandelbrot& mandelbrot);
 
+    void _colorize_rows(const Mandelbrot& mandelbrot, uint32_t y_start, uint32_t y_end);
+
   public:
+    // Upper bound of the maximum number of iterations, also for the automatic choice.
+    static constexpr uint32_t MAX_ITERATIONS = 32768U;
+
     sf::Uint8* pixels;
     sf::RenderWindow window;
 
+    // Events, coloring, upload and present time themselves, the caller adds
+    // the computation and ends the frames.
+    FrameTimer timing;
+
     Renderer(const uint32_t screen_width, const uint32_t screen_height);
 
     void check_events(sf::RenderWindow& window, Mandelbrot& mandelbrot);
 
     void update(Mandelbrot* mandelbrot);
 
+    // Only colors rows [y_start, y_end), e.g. while the frame is computed.
+    void update_rows(const Mandelbrot& mandelbrot, uint32_t y_start, uint32_t y_end);
+
     void show();
 };
 
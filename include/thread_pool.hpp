@@ -0,0 +1,52 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Fixed set of worker threads which stay alive for the whole process, so
+// consecutive frames do not pay for spawning threads again.
+class ThreadPool {
+  private:
+    std::vector<std::thread> _workers;
+    std::queue<std::function<void()>> _tasks;
+    std::mutex _mutex;
+    std::condition_variable _task_available;
+    bool _stopping = false;
+
+    void _run(unsigned int index);
+
+    void _enqueue(std::function<void()> task);
+
+  public:
+    // `n_threads == 0` uses one thread per hardware thread.
+    explicit ThreadPool(unsigned int n_threads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    unsigned int size() const;
+
+    template <typename F> auto submit(F task) -> std::future<std::invoke_result_t<F>> {
+        auto packaged = std::make_shared<std::packaged_task<std::invoke_result_t<F>()>>(std::move(task));
+        auto future = packaged->get_future();
+        _enqueue([packaged]() { (*packaged)(); });
+        return future;
+    }
+
+    // Pool used by default, created on first use.
+    static ThreadPool& shared();
+
+    // Number of threads of the shared pool, only effective before its first use.
+    static void set_shared_size(unsigned int n_threads);
+};
+
+#endif
@@ -0,0 +1,32 @@
+#ifndef TIFF_WRITER_H
+#define TIFF_WRITER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Streams RGBA rows into an uncompressed, tiled BigTIFF. All tiles have the
+// same size, so the offset table is known upfront and the tiles can be written
+// in order as soon as a row of tiles is complete. Only one row of tiles is
+// buffered, which makes it suitable for images far larger than memory.
+class TiffWriter {
+  private:
+    int _fd;
+    uint32_t _width;
+    uint32_t _height;
+    uint32_t _tiles_x;
+    std::vector<uint8_t> _tile_row;
+    uint32_t _rows_buffered = 0;
+    uint32_t _rows_written = 0;
+
+    void _write_tile_row();
+
+  public:
+    static constexpr uint32_t TILE_SIZE = 256U;
+
+    TiffWriter(int fd, uint32_t width, uint32_t height);
+
+    void write_rows(const uint8_t* rgba, uint32_t n_rows);
+};
+
+#endif
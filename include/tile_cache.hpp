@@ -0,0 +1,94 @@
+#ifndef TILE_CACHE_H
+#define TILE_CACHE_H
+
+#include "options.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+
+// Identifies a tile exactly: its position on the global pixel grid of one
+// pixel size, and everything else the values depend on.
+struct TileKey {
+    int64_t x; // Tile column, the first pixel is at real = x * TILE_WIDTH * pixel_size
+    int64_t y; // Tile row, the first pixel is at imag = -y * TILE_HEIGHT * pixel_size
+    uint64_t pixel_mantissa; // Pixel size is pixel_mantissa * 2^(pixel_exponent - 64)
+    int32_t pixel_exponent;
+    uint32_t reserved;
+    uint32_t n_iter_max;
+    uint32_t kernel;
+
+    bool operator==(const TileKey& other) const = default;
+};
+
+static_assert(sizeof(TileKey) == 40, "Key size is part of the file format");
+
+// Key of the tile at (0, 0). The pixel size is stored as its exact binary
+// mantissa and exponent, so equal keys have equal bytes on every run.
+TileKey make_tile_key(long double pixel_size, uint32_t n_iter_max, uint32_t kernel);
+
+// FNV-1a over the fields of the key.
+uint64_t hash_tile_key(const TileKey& key);
+
+// Where the engine looks up computed tiles before computing them itself.
+// Tiles are TILE_WIDTH x TILE_HEIGHT pixels, iterations and smooth values
+// stored row by row.
+class TileStore {
+  public:
+    static constexpr uint32_t TILE_WIDTH = 64U;
+    static constexpr uint32_t TILE_HEIGHT = 8U;
+    static constexpr size_t TILE_PIXELS = size_t(TILE_WIDTH) * TILE_HEIGHT;
+    static constexpr size_t TILE_BYTES = TILE_PIXELS * (sizeof(uint32_t) + sizeof(float));
+
+    virtual ~TileStore() = default;
+
+    // Copies the tile into `iterations` and `smooth` if present.
+    virtual bool lookup(const TileKey& key, uint32_t* iterations, float* smooth) = 0;
+
+    virtual void insert(const TileKey& key, const uint32_t* iterations, const float* smooth) = 0;
+};
+
+// Persistent, content-addressed cache of computed tiles. The file holds a
+// header, an open addressing index of keys and the tile data; it is memory
+// mapped, so entries survive the process and are shared between interactive
+// and export runs. Only one process uses a cache file at a time. When the
+// file is full it starts over.
+class TileCache : public TileStore {
+  private:
+    struct Header;
+    struct Slot;
+
+    int _fd = -1;
+    void* _mapping = nullptr;
+    size_t _size = 0;
+    Header* _header = nullptr;
+    Slot* _slots = nullptr;
+    uint8_t* _tiles = nullptr;
+
+    std::mutex _mutex;
+    std::atomic<uint64_t> _hits = 0;
+    std::atomic<uint64_t> _misses = 0;
+
+    Slot* _find(const TileKey& key);
+
+  public:
+    // Opens `path`, or creates it with room for `size` bytes of tiles.
+    TileCache(const std::string& path, size_t size);
+    ~TileCache() override;
+
+    TileCache(const TileCache&) = delete;
+    TileCache& operator=(const TileCache&) = delete;
+
+    bool lookup(const TileKey& key, uint32_t* iterations, float* smooth) override;
+
+    void insert(const TileKey& key, const uint32_t* iterations, const float* smooth) override;
+};
+
+// Opens the cache given by `--cache=path` (with `--cache-size` in MiB), or
+// returns null if no cache was requested or it is in use by another process.
+std::unique_ptr<TileCache> open_tile_cache(const Options& options);
+
+#endif
@@ -0,0 +1,83 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Opt-in timeline of the render scheduling, written as Chrome trace-event
+// JSON (chrome://tracing, ui.perfetto.dev). While disabled, spans and
+// instants only cost a relaxed atomic load.
+class Trace {
+  public:
+    // Complete event from construction to destruction on the calling thread.
+    // Names are string literals, they are stored as pointers.
+    class Span {
+      private:
+        const char* _name;
+        const char* _category;
+        const char* _arg_name;
+        int64_t _arg;
+        double _start;
+
+      public:
+        Span(const char* name, const char* category, const char* arg_name = nullptr, int64_t arg = 0);
+        ~Span();
+
+        Span(const Span&) = delete;
+        Span& operator=(const Span&) = delete;
+    };
+
+    // Further events are dropped, a long interactive session would otherwise
+    // grow without bounds.
+    static constexpr size_t MAX_EVENTS = size_t(1) << 22;
+
+  private:
+    struct Event {
+        const char* name;
+        const char* category;
+        char phase; // 'X' complete, 'i' instant
+        int tid;
+        double start; // Microseconds since the trace was enabled
+        double duration;
+        const char* arg_name;
+        int64_t arg;
+    };
+
+    std::atomic<bool> _enabled = false;
+    std::chrono::steady_clock::time_point _epoch;
+
+    mutable std::mutex _mutex;
+    std::vector<Event> _events;
+    std::map<int, std::string> _thread_names;
+    size_t _dropped = 0;
+
+    double _now() const;
+
+    void _record(const Event& event);
+
+    static int _thread_id();
+
+  public:
+    static Trace& shared();
+
+    // Starts recording, timestamps are relative to this call.
+    void enable();
+
+    bool enabled() const { return _enabled.load(std::memory_order_relaxed); }
+
+    // Point in time on the calling thread, e.g. a cancellation.
+    void instant(const char* name, const char* category);
+
+    // Names the calling thread in the timeline, also while disabled.
+    void set_thread_name(const std::string& name);
+
+    // Writes all events recorded so far.
+    void write(const std::string& path) const;
+};
+
+#endif
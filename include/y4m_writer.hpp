@@ -0,0 +1,34 @@
+#ifndef Y4M_WRITER_H
+#define Y4M_WRITER_H
+
+#include "thread_pool.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Writes RGBA frames as a YUV4MPEG2 stream (4:2:0, full range BT.601), which
+// video encoders like ffmpeg or x264 read directly from a pipe. The color
+// conversion of a frame is split into bands of rows on the pool.
+class Y4mWriter {
+  private:
+    static constexpr uint32_t BAND_HEIGHT = 32;
+
+    int _fd;
+    uint32_t _width;
+    uint32_t _height;
+    ThreadPool& _pool;
+    std::vector<uint8_t> _frame;
+
+    void _convert_rows(const uint8_t* rgba, uint32_t y_start, uint32_t y_end);
+
+  public:
+    Y4mWriter(int fd, uint32_t width, uint32_t height, uint32_t fps, ThreadPool& pool = ThreadPool::shared());
+
+    Y4mWriter(const Y4mWriter&) = delete;
+    Y4mWriter& operator=(const Y4mWriter&) = delete;
+
+    void write_frame(const uint8_t* rgba);
+};
+
+#endif
@@ -0,0 +1,108 @@
+#include "animation.hpp"
+
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <unistd.h>
+
+AnimationOutput::AnimationOutput(const Options& options, uint32_t width, uint32_t height, const Coloring& coloring)
+    : _format(parse_image_format(options.get("format", "p6"))), _width(width), _height(height),
+      _level(std::stoi(options.get("level", "6"))), coloring(coloring) {
+    if (_format == ImageFormat::GIF) {
+        // GIF animations end up in a single file, the encoder compresses
+        // finished frames on the pool while the next one is produced.
+        _destination = options.get("output", "animation.gif");
+        _fd = open_output_file(_destination);
+        _gif = std::make_unique<GifEncoder>(_fd, width, height, std::stoi(options.get("delay", "10")),
+                                            GifEncoder::parse_palette(options.get("palette", "global")));
+        _indices.resize(size_t(width) * height);
+        return;
+    }
+
+    // Streams go to stdout unless `--output` names a file or named pipe.
+    _stream = _format == ImageFormat::Y4M || options.has("stream");
+    if (_stream) {
+        _destination = options.get("output", "-");
+        _fd = _destination == "-" ? STDOUT_FILENO : open_output_file(_destination);
+        if (_format == ImageFormat::Y4M)
+            _y4m = std::make_unique<Y4mWriter>(_fd, width, height, std::stoi(options.get("fps", "25")));
+    }
+    else {
+        _destination = options.get("output", "frames");
+        std::filesystem::create_directories(_destination);
+    }
+
+    const size_t frame_size = size_t(width) * height * Colorizer::RGBA_SIZE;
+    _frames[0].resize(frame_size);
+    _frames[1].resize(frame_size);
+}
+
+AnimationOutput::~AnimationOutput() {
+    if (_encoding.valid())
+        _encoding.wait();
+    if (_fd >= 0 && _fd != STDOUT_FILENO)
+        ::close(_fd);
+}
+
+bool AnimationOutput::indexed() const {
+    return _gif != nullptr;
+}
+
+uint8_t* AnimationOutput::rgba() {
+    return _frames[_n_frames % 2].data();
+}
+
+uint16_t* AnimationOutput::indices() {
+    return _indices.data();
+}
+
+void AnimationOutput::write_rows(const float* smooth, uint32_t y_start, uint32_t y_end) {
+    const size_t first = size_t(y_start) * _width;
+    const size_t count = size_t(y_end - y_start) * _width;
+
+    if (indexed())
+        Colorizer::gradient_indices(smooth, indices() + first, count, coloring);
+    else
+        Colorizer::colorize(smooth, rgba() + first * Colorizer::RGBA_SIZE, count, coloring);
+}
+
+void AnimationOutput::commit() {
+    if (indexed()) {
+        _gif->add_frame(_indices.data());
+        _n_frames++;
+        return;
+    }
+
+    // The other buffer is only reused once its frame has been written.
+    if (_encoding.valid())
+        _encoding.get();
+
+    // Frames of a stream are written in order, the next one is only
+    // committed after the previous write has finished.
+    if (_stream) {
+        const uint8_t* frame = rgba();
+        if (_y4m)
+            _encoding = std::async(std::launch::async, [this, frame]() { _y4m->write_frame(frame); });
+        else
+            _encoding = std::async(std::launch::async, write_image, _fd, _format, _width, _height, frame, _level);
+        _n_frames++;
+        return;
+    }
+
+    char name[32];
+    std::snprintf(name, sizeof(name), "%05zu", _n_frames + 1);
+    std::string path = (std::filesystem::path(_destination) / (name + image_extension(_format))).string();
+
+    _encoding = std::async(std::launch::async, write_image_file, path, _format, _width, _height, rgba(), _level);
+    _n_frames++;
+}
+
+void AnimationOutput::finish() {
+    if (indexed())
+        _gif->finish();
+    if (_encoding.valid())
+        _encoding.get();
+
+    std::cerr << "\n[INFO] " << _n_frames << " frames written to " << (_destination == "-" ? "stdout" : _destination)
+              << std::endl;
+}
@@ -0,0 +1,68 @@
+#include "colorizer.hpp"
+#include "colors.h"
+
+#include <algorithm>
+#include <cmath>
+
+void Colorizer::colorize(const Mandelbrot& mandelbrot, uint8_t* pixels, const Coloring& coloring) {
+    colorize(mandelbrot.smooth, pixels, size_t(mandelbrot.width) * mandelbrot.height, coloring);
+}
+
+void Colorizer::colorize(const float* smooth, uint8_t* pixels, size_t count, const Coloring& coloring) {
+    size_t n_pixel = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        uint16_t idx = gradient_index(smooth[i], coloring);
+
+        if (idx == INTERIOR) {
+            pixels[n_pixel++] = 0;
+            pixels[n_pixel++] = 0;
+            pixels[n_pixel++] = 0;
+            pixels[n_pixel++] = 255;
+            continue;
+        };
+
+        pixels[n_pixel++] = COLOR_TABLE[idx][0];
+        pixels[n_pixel++] = COLOR_TABLE[idx][1];
+        pixels[n_pixel++] = COLOR_TABLE[idx][2];
+        pixels[n_pixel++] = 255;
+    }
+}
+
+void Colorizer::gradient_indices(const float* smooth, uint16_t* indices, size_t count, const Coloring& coloring) {
+    for (size_t i = 0; i < count; i++)
+        indices[i] = gradient_index(smooth[i], coloring);
+}
+
+uint16_t Colorizer::gradient_index(float smooth, const Coloring& coloring) {
+    // Source: https://github.com/josch/mandelbrot (Wikipedia animation)
+    const double LOG_2 = 0.69314718055994530941723212145817656807550013436026;
+
+    if (smooth == Mandelbrot::INTERIOR)
+        return INTERIOR;
+
+    double c = smooth - coloring.offset;
+    // The gradient is cyclic, rounding up at the very end wraps to the start.
+    double position = std::fmod(std::log(c / coloring.scale + 1) / LOG_2 + coloring.phase, 1.0);
+    if (position < 0)
+        position += 1.0;
+    return size_t(position * GRADIENT_LENGTH + 0.5) % GRADIENT_LENGTH;
+}
+
+void Colorizer::heatmap(const float* heat, uint8_t* pixels, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        const float value = std::clamp(heat[i], 0.0f, 1.0f) * 3.0f;
+        pixels[4 * i + 0] = uint8_t(std::clamp(value, 0.0f, 1.0f) * 255.0f);
+        pixels[4 * i + 1] = uint8_t(std::clamp(value - 1.0f, 0.0f, 1.0f) * 255.0f);
+        pixels[4 * i + 2] = uint8_t(std::clamp(value - 2.0f, 0.0f, 1.0f) * 255.0f);
+        pixels[4 * i + 3] = 255;
+    }
+}
+
+uint16_t Colorizer::gradient_length() {
+    return GRADIENT_LENGTH;
+}
+
+const uint8_t* Colorizer::gradient_color(uint16_t index) {
+    return COLOR_TABLE[index];
+}
@@ -0,0 +1,249 @@
+#include "export.hpp"
+#include "animation.hpp"
+#include "colorizer.hpp"
+#include "gif_encoder.hpp"
+#include "image_writer.hpp"
+#include "iteration_map.hpp"
+#include "keyframes.hpp"
+#include "logpolar.hpp"
+#include "mandelbrot.hpp"
+#include "png_encoder.hpp"
+#include "tile_cache.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+Coloring parse_coloring(const Options& options) {
+    Coloring coloring;
+    coloring.offset = std::stof(options.get("offset", std::to_string(coloring.offset)));
+    coloring.scale = std::stof(options.get("scale", std::to_string(coloring.scale)));
+    coloring.phase = std::stof(options.get("phase", std::to_string(coloring.phase)));
+    return coloring;
+}
+
+// Colors rows of smooth iteration values as they become available and writes
+// them in the requested format. Streaming formats are written band by band,
+// PNG, GIF and Y4M need the whole frame and are encoded by `finish`.
+class FrameOutput {
+  private:
+    int _fd;
+    ImageFormat _format;
+    uint32_t _width;
+    uint32_t _height;
+    Coloring _coloring;
+    const Options& _options;
+
+    std::unique_ptr<ImageWriter> _writer;
+    std::vector<uint8_t> _rgba;
+    std::vector<uint16_t> _indices;
+
+  public:
+    FrameOutput(int fd, const Options& options, uint32_t width, uint32_t height)
+        : _fd(fd), _format(parse_image_format(options.get("format", "p6"))), _width(width), _height(height),
+          _coloring(parse_coloring(options)), _options(options) {
+        if (_format == ImageFormat::GIF)
+            _indices.resize(size_t(width) * height);
+        else if (_format == ImageFormat::PNG || _format == ImageFormat::Y4M)
+            _rgba.resize(size_t(width) * height * Colorizer::RGBA_SIZE);
+        else
+            _writer = std::make_unique<ImageWriter>(fd, _format, width, height);
+    }
+
+    // `smooth` points to the first value of row `y_start`.
+    void write_rows(const float* smooth, uint32_t y_start, uint32_t y_end) {
+        const size_t first = size_t(y_start) * _width;
+        const size_t count = size_t(y_end - y_start) * _width;
+
+        if (_format == ImageFormat::GIF) {
+            Colorizer::gradient_indices(smooth, _indices.data() + first, count, _coloring);
+        }
+        else if (_format == ImageFormat::PNG || _format == ImageFormat::Y4M) {
+            Colorizer::colorize(smooth, _rgba.data() + first * Colorizer::RGBA_SIZE, count, _coloring);
+        }
+        else {
+            _rgba.resize(count * Colorizer::RGBA_SIZE);
+            Colorizer::colorize(smooth, _rgba.data(), count, _coloring);
+            _writer->write_rows(_rgba.data(), y_end - y_start);
+        }
+    }
+
+    void finish() {
+        if (_format == ImageFormat::GIF) {
+            GifEncoder gif(_fd, _width, _height, 0, GifEncoder::parse_palette(_options.get("palette", "frame")));
+            gif.add_frame(_indices.data());
+            gif.finish();
+        }
+        else if (_format == ImageFormat::PNG || _format == ImageFormat::Y4M) {
+            write_image(_fd, _format, _width, _height, _rgba.data(), std::stoi(_options.get("level", "6")));
+        }
+        else {
+            _writer->flush();
+        }
+    }
+};
+
+// Magnification of every frame: 1, gain, gain^2, ... and the target as last frame.
+std::vector<long double> zoom_steps(long double target_magnification, long double gain) {
+    if (gain <= 1.0L)
+        throw std::invalid_argument("Magnification gain must be greater than 1");
+
+    std::vector<long double> steps = {1.0L};
+    while (steps.back() < target_magnification)
+        steps.push_back(steps.back() * gain);
+    steps.back() = target_magnification;
+
+    return steps;
+}
+
+} // namespace
+
+void export_frame(const Options& options) {
+    const std::vector<std::string>& args = options.positional;
+    const uint32_t width = std::stoi(args[0]);
+    const uint32_t height = std::stoi(args[1]);
+
+    // Frames larger than the memory budget are computed in strips of rows.
+    const size_t budget = std::stoull(options.get("memory", "1024")) << 20;
+    const size_t bytes_per_row = size_t(width) * (sizeof(uint32_t) + sizeof(float));
+    uint32_t strip_height = std::min<size_t>(height, budget / bytes_per_row);
+    if (strip_height < height)
+        strip_height = std::max(strip_height / Mandelbrot::BAND_HEIGHT * Mandelbrot::BAND_HEIGHT, Mandelbrot::BAND_HEIGHT);
+
+    std::unique_ptr<TileCache> cache = open_tile_cache(options);
+    Mandelbrot mandelbrot(width, std::min(strip_height, height));
+    mandelbrot.tile_cache = cache.get();
+
+    mandelbrot.center_point = {parse_coordinate(args[2]), parse_coordinate(args[3])};
+    mandelbrot.n_iter_max = std::stoi(args[4]);
+    mandelbrot.magnification = std::stold(args[5]);
+    mandelbrot.frame_height = height;
+    mandelbrot.kernel = Mandelbrot::parse_kernel(options.get("kernel", "direct"));
+    // The limit is chosen before the first strip, the iteration map header records it.
+    const bool auto_iterations = options.has("auto-iterations");
+    if (auto_iterations)
+        mandelbrot.n_iter_max = mandelbrot.choose_iterations(mandelbrot.n_iter_max);
+
+    const std::string format = options.get("format", "p6");
+    const bool whole_frame = format == "png" || format == "gif" || format == "y4m";
+    if (whole_frame && mandelbrot.height < height)
+        throw std::invalid_argument("Frame exceeds the memory budget, use --format=p6, rgba, tiff or itmap");
+
+    // Raw smooth iteration values, to be recolored later without computing again.
+    std::unique_ptr<IterationMapWriter> map_writer;
+    std::unique_ptr<FrameOutput> output;
+    if (format == "itmap")
+        map_writer = std::make_unique<IterationMapWriter>(STDOUT_FILENO, mandelbrot);
+    else
+        output = std::make_unique<FrameOutput>(STDOUT_FILENO, options, width, height);
+
+    // Rows are colored and streamed to stdout band by band while the workers
+    // continue with the rest of the strip.
+    for (uint32_t row_offset = 0; row_offset < height; row_offset += mandelbrot.height) {
+        if (mandelbrot.height < height)
+            std::cerr << "\r[INFO] Rendering rows " << row_offset << " to "
+                      << std::min(row_offset + mandelbrot.height, height) << " of " << height << "   " << std::flush;
+
+        mandelbrot.row_offset = row_offset;
+        mandelbrot.has_changed = true;
+        mandelbrot.update([&](uint32_t y_start, uint32_t y_end) {
+            const float* smooth = mandelbrot.smooth + size_t(y_start) * width;
+            if (map_writer)
+                map_writer->write_rows(smooth, row_offset + y_start, row_offset + y_end);
+            else
+                output->write_rows(smooth, row_offset + y_start, row_offset + y_end);
+        });
+    }
+
+    if (output)
+        output->finish();
+    if (mandelbrot.height < height)
+        std::cerr << std::endl;
+    if (auto_iterations)
+        std::cerr << "[INFO] Maximum number of iterations: " << mandelbrot.n_iter_max << std::endl;
+}
+
+void export_animation(const Options& options) {
+    const std::vector<std::string>& args = options.positional;
+    const uint32_t width = std::stoi(args[0]);
+    const uint32_t height = std::stoi(args[1]);
+
+    long double gain = std::stold(options.get("gain", "1.25"));
+    if (options.has("frames-per-octave"))
+        gain = powl(2.0L, 1.0L / std::stold(options.get("frames-per-octave", "")));
+    const std::vector<long double> steps = zoom_steps(std::stold(args[5]), gain);
+
+    AnimationOutput output(options, width, height, parse_coloring(options));
+    const Mandelbrot::Kernel kernel = Mandelbrot::parse_kernel(options.get("kernel", "direct"));
+    const uint32_t auto_iterations = options.has("auto-iterations") ? std::stoi(args[4]) : 0;
+
+    if (options.has("keyframes")) {
+        Complex center = {parse_coordinate(args[2]), parse_coordinate(args[3])};
+        KeyframeZoom zoom(width, height, center, std::stoi(args[4]), std::stof(options.get("oversample", "2")));
+        zoom.kernel = kernel;
+        zoom.auto_iterations = auto_iterations;
+        zoom.render(steps, output);
+        output.finish();
+        return;
+    }
+
+    if (options.has("logpolar")) {
+        if (auto_iterations > 0)
+            throw std::invalid_argument("--auto-iterations is not supported with --logpolar");
+        Complex center = {parse_coordinate(args[2]), parse_coordinate(args[3])};
+        LogPolarZoom zoom(width, height, center, std::stoi(args[4]), std::stoi(options.get("strip-width", "0")));
+        zoom.kernel = kernel;
+        zoom.memory = std::stoull(options.get("memory", "1024")) << 20;
+        zoom.render(steps, output);
+        output.finish();
+        return;
+    }
+
+    std::unique_ptr<TileCache> cache = open_tile_cache(options);
+    Mandelbrot mandelbrot(width, height);
+    mandelbrot.tile_cache = cache.get();
+    mandelbrot.kernel = kernel;
+    mandelbrot.center_point = {parse_coordinate(args[2]), parse_coordinate(args[3])};
+    mandelbrot.n_iter_max = std::stoi(args[4]);
+    mandelbrot.reserve_precision(steps.back());
+
+    for (size_t i = 0; i < steps.size(); i++) {
+        mandelbrot.magnification = steps[i];
+        mandelbrot.has_changed = true;
+        // Zooming in never needs fewer iterations, keeping them avoids
+        // flickering boundary pixels.
+        if (auto_iterations > 0)
+            mandelbrot.n_iter_max = mandelbrot.choose_iterations(auto_iterations, i > 0 ? mandelbrot.n_iter_max : 0);
+        mandelbrot.update([&](uint32_t y_start, uint32_t y_end) {
+            output.write_rows(mandelbrot.smooth + size_t(y_start) * width, y_start, y_end);
+        });
+        output.commit();
+
+        std::cerr << "\r[INFO] Rendered frame " << i + 1 << " of " << steps.size() << "  |  Magnification "
+                  << steps[i] << "  |  Iterations " << mandelbrot.n_iter_max << "   " << std::flush;
+    }
+
+    output.finish();
+}
+
+void recolor(const Options& options) {
+    const IterationMap map(options.get("recolor", ""));
+    const uint32_t width = map.header->width;
+    const uint32_t height = map.header->height;
+
+    FrameOutput output(STDOUT_FILENO, options, width, height);
+    std::vector<float> rows(size_t(width) * Mandelbrot::BAND_HEIGHT);
+
+    for (uint32_t y = 0; y < height; y += Mandelbrot::BAND_HEIGHT) {
+        uint32_t y_end = std::min(y + Mandelbrot::BAND_HEIGHT, height);
+        map.read_rows(y, y_end, rows.data());
+        output.write_rows(rows.data(), y, y_end);
+    }
+    output.finish();
+}
@@ -0,0 +1,141 @@
+#include "frame_timer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+
+FrameTimer::Scope::Scope(FrameTimer& timer, Stage stage)
+    : _timer(timer), _previous(timer._switch(int(stage))), _span(stage_name(stage), "stage") {}
+
+FrameTimer::Scope::~Scope() {
+    _timer._switch(_previous);
+}
+
+FrameTimer::FrameTimer() : _since(Clock::now()) {
+    _frames.reserve(CAPACITY);
+    _current.fill(std::numeric_limits<double>::quiet_NaN());
+    _last.fill(0.0);
+}
+
+int FrameTimer::_switch(int stage) {
+    // Stages entered in a frame count as run, even if the time is zero.
+    const Clock::time_point now = Clock::now();
+    if (_stage >= 0 && !std::isnan(_current[_stage]))
+        _current[_stage] += std::chrono::duration<double>(now - _since).count();
+    if (stage >= 0 && std::isnan(_current[stage]))
+        _current[stage] = 0.0;
+
+    _since = now;
+
+    if (_counters != nullptr) {
+        const PerfCounters::Values values = _counters->read();
+        const PerfCounters::Values main_values = _main_counters->read();
+        for (size_t i = 0; i < PerfCounters::N_COUNTERS; i++) {
+            // Multiplexed counts are estimates, the difference can come out negative.
+            const uint64_t all = values[i] - _counters_since[i];
+            const uint64_t main = main_values[i] - _main_counters_since[i];
+            _counter_totals[size_t(Stage::COMPUTE)][i] += all > main ? all - main : 0;
+            if (_stage >= 0)
+                _counter_totals[_stage][i] += main;
+        }
+        _counters_since = values;
+        _main_counters_since = main_values;
+    }
+
+    std::swap(_stage, stage);
+    return stage;
+}
+
+void FrameTimer::set_counters(const PerfCounters* counters, const PerfCounters* main_counters,
+                              uint64_t pixels_per_frame) {
+    _counters = counters;
+    _main_counters = main_counters;
+    _pixels_per_frame = pixels_per_frame;
+    if (_counters != nullptr) {
+        _counters_since = _counters->read();
+        _main_counters_since = _main_counters->read();
+    }
+}
+
+void FrameTimer::end_frame() {
+    for (size_t i = 0; i < N_STAGES; i++) {
+        if (!std::isnan(_current[i])) {
+            _last[i] = _current[i];
+            _runs[i]++;
+        }
+    }
+
+    if (_frames.size() < CAPACITY)
+        _frames.push_back(_current);
+    else
+        _frames[_next] = _current;
+    _next = (_next + 1) % CAPACITY;
+    _current.fill(std::numeric_limits<double>::quiet_NaN());
+}
+
+double FrameTimer::last(Stage stage) const {
+    return _last[size_t(stage)];
+}
+
+double FrameTimer::percentile(Stage stage, double p) const {
+    std::vector<double> values;
+    values.reserve(_frames.size());
+    for (const Sample& frame : _frames)
+        if (!std::isnan(frame[size_t(stage)]))
+            values.push_back(frame[size_t(stage)]);
+    if (values.empty())
+        return 0.0;
+
+    auto nth = values.begin() + std::min(values.size() - 1, size_t(p * values.size()));
+    std::nth_element(values.begin(), nth, values.end());
+    return *nth;
+}
+
+void FrameTimer::report(std::ostream& out) const {
+    char line[128];
+    std::snprintf(line, sizeof(line), "%-10s %8s %10s %10s %10s\n", "Stage", "Frames", "p50 [ms]", "p95 [ms]",
+                  "p99 [ms]");
+    out << line;
+    for (size_t i = 0; i < N_STAGES; i++) {
+        const Stage stage = Stage(i);
+        const size_t n = std::count_if(_frames.begin(), _frames.end(),
+                                       [i](const Sample& frame) { return !std::isnan(frame[i]); });
+        std::snprintf(line, sizeof(line), "%-10s %8zu %10.3f %10.3f %10.3f\n", stage_name(stage), n,
+                      percentile(stage, 0.50) * 1e3, percentile(stage, 0.95) * 1e3, percentile(stage, 0.99) * 1e3);
+        out << line;
+    }
+    if (_counters == nullptr)
+        return;
+
+    using Counter = PerfCounters::Counter;
+    std::snprintf(line, sizeof(line), "%-10s %8s %14s %14s %14s\n", "Stage", "IPC", "Cache miss/px",
+                  "Branch miss/px", "Raw/px");
+    out << line;
+    for (size_t i = 0; i < N_STAGES; i++) {
+        const PerfCounters::Values& totals = _counter_totals[i];
+        const double cycles = totals[size_t(Counter::CYCLES)];
+        const double pixels = std::max<double>(1.0, double(_runs[i]) * _pixels_per_frame);
+        std::snprintf(line, sizeof(line), "%-10s %8.3f %14.4f %14.4f %14.4f\n", stage_name(Stage(i)),
+                      cycles > 0 ? totals[size_t(Counter::INSTRUCTIONS)] / cycles : 0.0,
+                      totals[size_t(Counter::CACHE_MISSES)] / pixels, totals[size_t(Counter::BRANCH_MISSES)] / pixels,
+                      totals[size_t(Counter::RAW)] / pixels);
+        out << line;
+    }
+}
+
+const char* FrameTimer::stage_name(Stage stage) {
+    switch (stage) {
+    case Stage::EVENTS:
+        return "Events";
+    case Stage::COMPUTE:
+        return "Compute";
+    case Stage::COLOR:
+        return "Color";
+    case Stage::UPLOAD:
+        return "Upload";
+    case Stage::PRESENT:
+        return "Present";
+    }
+    return "";
+}
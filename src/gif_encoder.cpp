@@ -0,0 +1,280 @@
+#include "gif_encoder.hpp"
+#include "colorizer.hpp"
+#include "image_writer.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+
+constexpr uint8_t MIN_CODE_SIZE = 8;
+constexpr uint16_t CLEAR_CODE = 1U << MIN_CODE_SIZE;
+constexpr uint16_t END_CODE = CLEAR_CODE + 1;
+constexpr uint16_t MAX_CODES = 4096;
+constexpr size_t HASH_SIZE = 8192;
+
+void put_u16(std::vector<uint8_t>& out, uint16_t value) {
+    out.push_back(value & 0xFF);
+    out.push_back(value >> 8);
+}
+
+uint32_t pack_rgb(const uint8_t* rgb) {
+    return uint32_t(rgb[0]) << 16 | uint32_t(rgb[1]) << 8 | rgb[2];
+}
+
+struct BitWriter {
+    std::vector<uint8_t> bytes;
+    uint32_t buffer = 0;
+    uint8_t n_bits = 0;
+
+    void put(uint16_t code, uint8_t size) {
+        buffer |= uint32_t(code) << n_bits;
+        n_bits += size;
+        while (n_bits >= 8) {
+            bytes.push_back(buffer & 0xFF);
+            buffer >>= 8;
+            n_bits -= 8;
+        }
+    }
+
+    void flush() {
+        if (n_bits > 0)
+            bytes.push_back(buffer & 0xFF);
+        buffer = 0;
+        n_bits = 0;
+    }
+};
+
+} // namespace
+
+GifEncoder::GifEncoder(int fd, uint32_t width, uint32_t height, uint16_t delay, Palette palette, ThreadPool& pool)
+    : _fd(fd), _width(width), _height(height), _delay(delay), _palette_mode(palette), _pool(pool),
+      _displayed(size_t(width) * height, 0) {
+    std::vector<uint8_t> header = {'G', 'I', 'F', '8', '9', 'a'};
+    put_u16(header, width);
+    put_u16(header, height);
+
+    if (palette == Palette::GLOBAL) {
+        // Even samples of the gradient, each entry takes the center of its range.
+        _global_palette.assign(3 * 256, 0);
+        for (uint16_t i = 0; i < N_GRADIENT_COLORS; i++) {
+            uint16_t idx = (2 * i + 1) * Colorizer::gradient_length() / (2 * N_GRADIENT_COLORS);
+            std::copy_n(Colorizer::gradient_color(idx), 3, &_global_palette[3 * (i + 2)]);
+        }
+        header.insert(header.end(), {0xF7, 0, 0}); // Global table of 256 colors
+        header.insert(header.end(), _global_palette.begin(), _global_palette.end());
+    }
+    else {
+        header.insert(header.end(), {0x70, 0, 0}); // No global table
+    }
+
+    // Loop forever
+    header.insert(header.end(), {0x21, 0xFF, 0x0B, 'N', 'E', 'T', 'S', 'C', 'A', 'P', 'E', '2', '.', '0', 3, 1, 0, 0, 0});
+    write_all(_fd, header.data(), header.size());
+}
+
+void GifEncoder::add_frame(const uint16_t* indices) {
+    const size_t n_pixels = size_t(_width) * _height;
+
+    std::vector<uint8_t> lookup;
+    std::vector<uint8_t> palette =
+        _palette_mode == Palette::GLOBAL ? _global_palette : _build_palette(indices, lookup);
+
+    if (_palette_mode == Palette::GLOBAL) {
+        lookup.resize(Colorizer::gradient_length());
+        for (uint16_t idx = 0; idx < Colorizer::gradient_length(); idx++)
+            lookup[idx] = 2 + uint32_t(idx) * N_GRADIENT_COLORS / Colorizer::gradient_length();
+    }
+
+    // Map to palette entries and find the area which differs from what is
+    // currently displayed.
+    std::vector<uint8_t> entries(n_pixels);
+    uint32_t x_min = _width, x_max = 0, y_min = _height, y_max = 0;
+
+    for (uint32_t y = 0; y < _height; y++) {
+        for (uint32_t x = 0; x < _width; x++) {
+            size_t i = size_t(y) * _width + x;
+            uint8_t entry = indices[i] == Colorizer::INTERIOR ? INTERIOR : lookup[indices[i]];
+            uint32_t rgb = pack_rgb(&palette[3 * entry]);
+
+            if (!_first_frame && rgb == _displayed[i]) {
+                entries[i] = TRANSPARENT;
+                continue;
+            }
+            entries[i] = entry;
+            _displayed[i] = rgb;
+            x_min = std::min(x_min, x);
+            x_max = std::max(x_max, x);
+            y_min = std::min(y_min, y);
+            y_max = std::max(y_max, y);
+        }
+    }
+
+    // Nothing changed, a single transparent pixel keeps the frame timing.
+    if (x_min > x_max) {
+        x_min = x_max = y_min = y_max = 0;
+        entries[0] = TRANSPARENT;
+    }
+
+    const uint32_t crop_width = x_max - x_min + 1;
+    const uint32_t crop_height = y_max - y_min + 1;
+    std::vector<uint8_t> cropped(size_t(crop_width) * crop_height);
+    for (uint32_t y = 0; y < crop_height; y++)
+        std::copy_n(&entries[size_t(y + y_min) * _width + x_min], crop_width, &cropped[size_t(y) * crop_width]);
+
+    // Graphic control extension: keep previous frame, entry 0 is transparent.
+    std::vector<uint8_t> frame = {0x21, 0xF9, 0x04, uint8_t(_first_frame ? 0x04 : 0x05)};
+    put_u16(frame, _delay);
+    frame.insert(frame.end(), {TRANSPARENT, 0x00});
+
+    frame.push_back(0x2C);
+    put_u16(frame, x_min);
+    put_u16(frame, y_min);
+    put_u16(frame, crop_width);
+    put_u16(frame, crop_height);
+    if (_palette_mode == Palette::FRAME) {
+        frame.push_back(0x87); // Local table of 256 colors
+        frame.insert(frame.end(), palette.begin(), palette.end());
+    }
+    else {
+        frame.push_back(0x00);
+    }
+
+    _first_frame = false;
+
+    _pending.push_back(_pool.submit(
+        [frame = std::move(frame), cropped = std::move(cropped)]() mutable {
+            std::vector<uint8_t> data = lzw_compress(cropped);
+
+            frame.push_back(MIN_CODE_SIZE);
+            for (size_t offset = 0; offset < data.size(); offset += 255) {
+                size_t size = std::min<size_t>(255, data.size() - offset);
+                frame.push_back(size);
+                frame.insert(frame.end(), data.begin() + offset, data.begin() + offset + size);
+            }
+            frame.push_back(0x00);
+            return std::move(frame);
+        }));
+
+    _write_ready(_pool.size());
+}
+
+void GifEncoder::finish() {
+    _write_ready(0);
+
+    const uint8_t trailer = 0x3B;
+    write_all(_fd, &trailer, 1);
+}
+
+void GifEncoder::_write_ready(size_t max_pending) {
+    while (!_pending.empty()) {
+        auto& front = _pending.front();
+        if (_pending.size() <= max_pending && front.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+            return;
+
+        std::vector<uint8_t> frame = front.get();
+        write_all(_fd, frame.data(), frame.size());
+        _pending.pop_front();
+    }
+}
+
+std::vector<uint8_t> GifEncoder::_build_palette(const uint16_t* indices, std::vector<uint8_t>& lookup) const {
+    const uint16_t length = Colorizer::gradient_length();
+    const size_t n_pixels = size_t(_width) * _height;
+
+    std::vector<size_t> histogram(length, 0);
+    size_t total = 0;
+    for (size_t i = 0; i < n_pixels; i++) {
+        if (indices[i] != Colorizer::INTERIOR) {
+            histogram[indices[i]]++;
+            total++;
+        }
+    }
+
+    // Split the gradient into ranges of equal weight. Each index weighs its
+    // pixel count plus an even share, so frequent colors get entries of their
+    // own while rarely used parts are still covered at half the global density.
+    std::vector<uint8_t> palette(3 * 256, 0);
+    lookup.assign(length, 0);
+
+    const uint64_t total_weight = 2 * uint64_t(total) * length + length;
+    uint64_t cumulative = 0;
+    uint64_t weighted_sum = 0, count = 0;
+    uint16_t entry = 0, range_start = 0;
+
+    for (uint16_t idx = 0; idx < length; idx++) {
+        cumulative += uint64_t(histogram[idx]) * length + total + 1;
+        weighted_sum += uint64_t(histogram[idx]) * idx;
+        count += histogram[idx];
+        lookup[idx] = 2 + entry;
+
+        if (idx + 1 == length || cumulative * N_GRADIENT_COLORS >= total_weight * (entry + 1u)) {
+            uint16_t color = count > 0 ? weighted_sum / count : (range_start + idx) / 2;
+            std::copy_n(Colorizer::gradient_color(color), 3, &palette[3 * (2 + entry)]);
+            entry = std::min<uint16_t>(entry + 1, N_GRADIENT_COLORS - 1);
+            range_start = idx + 1;
+            weighted_sum = count = 0;
+        }
+    }
+
+    return palette;
+}
+
+GifEncoder::Palette GifEncoder::parse_palette(const std::string& name) {
+    if (name == "global")
+        return Palette::GLOBAL;
+    if (name == "frame")
+        return Palette::FRAME;
+    throw std::invalid_argument("Unknown GIF palette: " + name);
+}
+
+std::vector<uint8_t> GifEncoder::lzw_compress(const std::vector<uint8_t>& pixels) {
+    BitWriter writer;
+    std::vector<int32_t> keys(HASH_SIZE);
+    std::vector<uint16_t> codes(HASH_SIZE);
+
+    uint16_t next_code;
+    uint8_t code_size;
+    auto reset = [&]() {
+        std::fill(keys.begin(), keys.end(), -1);
+        next_code = END_CODE + 1;
+        code_size = MIN_CODE_SIZE + 1;
+    };
+
+    reset();
+    writer.put(CLEAR_CODE, code_size);
+
+    int32_t prefix = pixels.empty() ? -1 : pixels[0];
+    for (size_t i = 1; i < pixels.size(); i++) {
+        int32_t key = prefix << 8 | pixels[i];
+        size_t slot = (uint32_t(key) * 2654435761U) >> 19;
+        while (keys[slot] != -1 && keys[slot] != key)
+            slot = (slot + 1) & (HASH_SIZE - 1);
+
+        if (keys[slot] == key) {
+            prefix = codes[slot];
+            continue;
+        }
+
+        writer.put(prefix, code_size);
+        if (next_code < MAX_CODES) {
+            keys[slot] = key;
+            codes[slot] = next_code++;
+            // The decoder adds entries one code later, hence `>` instead of `>=`.
+            if (next_code > (1U << code_size) && code_size < 12)
+                code_size++;
+        }
+        else {
+            writer.put(CLEAR_CODE, code_size);
+            reset();
+        }
+        prefix = pixels[i];
+    }
+
+    if (prefix >= 0)
+        writer.put(prefix, code_size);
+    writer.put(END_CODE, code_size);
+    writer.flush();
+
+    return std::move(writer.bytes);
+}
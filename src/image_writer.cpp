@@ -0,0 +1,178 @@
+#include "image_writer.hpp"
+#include "png_encoder.hpp"
+#include "y4m_writer.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+
+ImageFormat parse_image_format(const std::string& name) {
+    if (name == "p3")
+        return ImageFormat::P3;
+    if (name == "p6")
+        return ImageFormat::P6;
+    if (name == "rgba")
+        return ImageFormat::RGBA;
+    if (name == "png")
+        return ImageFormat::PNG;
+    if (name == "gif")
+        return ImageFormat::GIF;
+    if (name == "tiff")
+        return ImageFormat::TIFF;
+    if (name == "y4m")
+        return ImageFormat::Y4M;
+    throw std::invalid_argument("Unknown image format: " + name);
+}
+
+std::string image_extension(ImageFormat format) {
+    switch (format) {
+    case ImageFormat::RGBA:
+        return ".rgba";
+    case ImageFormat::PNG:
+        return ".png";
+    case ImageFormat::GIF:
+        return ".gif";
+    case ImageFormat::TIFF:
+        return ".tif";
+    case ImageFormat::Y4M:
+        return ".y4m";
+    default:
+        return ".ppm";
+    }
+}
+
+void write_all(int fd, const uint8_t* data, size_t size) {
+    size_t written = 0;
+
+    while (written < size) {
+        ssize_t n = ::write(fd, data + written, size - written);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            throw std::runtime_error(std::string("Writing image failed: ") + std::strerror(errno));
+        written += n;
+    }
+}
+
+int open_output_file(const std::string& path) {
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        throw std::runtime_error("Cannot open " + path + ": " + std::strerror(errno));
+    return fd;
+}
+
+void write_image(int fd, ImageFormat format, uint32_t width, uint32_t height, const uint8_t* rgba, int level) {
+    if (format == ImageFormat::PNG) {
+        std::vector<uint8_t> png = PngEncoder::encode(rgba, width, height, level);
+        write_all(fd, png.data(), png.size());
+        return;
+    }
+    if (format == ImageFormat::Y4M) {
+        Y4mWriter(fd, width, height, 25).write_frame(rgba);
+        return;
+    }
+
+    ImageWriter writer(fd, format, width, height);
+    writer.write_rows(rgba, height);
+    writer.flush();
+}
+
+void write_image_file(const std::string& path, ImageFormat format, uint32_t width, uint32_t height,
+                      const uint8_t* rgba, int level) {
+    int fd = open_output_file(path);
+
+    try {
+        write_image(fd, format, width, height, rgba, level);
+    }
+    catch (...) {
+        ::close(fd);
+        throw;
+    }
+    ::close(fd);
+}
+
+ImageWriter::ImageWriter(int fd, ImageFormat format, uint32_t width, uint32_t height)
+    : _fd(fd), _format(format), _width(width) {
+    if (format == ImageFormat::PNG || format == ImageFormat::GIF || format == ImageFormat::Y4M)
+        throw std::invalid_argument("PNG, GIF and Y4M can not be streamed row by row");
+
+    if (format == ImageFormat::TIFF) {
+        _tiff = std::make_unique<TiffWriter>(fd, width, height);
+        return;
+    }
+
+    _buffer.reserve(BUFFER_SIZE);
+
+    std::string header;
+    if (format == ImageFormat::P3)
+        header = "P3\n" + std::to_string(width) + "\n" + std::to_string(height) + "\n255\n";
+    else if (format == ImageFormat::P6)
+        header = "P6\n" + std::to_string(width) + " " + std::to_string(height) + "\n255\n";
+
+    _put(header.data(), header.size());
+}
+
+ImageWriter::~ImageWriter() {
+    try {
+        flush();
+    }
+    catch (const std::exception&) {
+        // Nothing sensible left to do, e.g. the reading end of a pipe is gone.
+    }
+}
+
+void ImageWriter::write_rows(const uint8_t* rgba, uint32_t n_rows) {
+    const size_t n_pixels = size_t(_width) * n_rows;
+
+    switch (_format) {
+    case ImageFormat::RGBA:
+        _put(rgba, n_pixels * 4);
+        break;
+
+    case ImageFormat::P6:
+        for (size_t i = 0; i < n_pixels; i++) {
+            if (_buffer.size() + 3 > BUFFER_SIZE)
+                flush();
+            _buffer.insert(_buffer.end(), rgba + 4 * i, rgba + 4 * i + 3);
+        }
+        break;
+
+    case ImageFormat::P3:
+        for (size_t i = 0; i < n_pixels; i++) {
+            std::string line = std::to_string(rgba[4 * i + 0]) + " " + std::to_string(rgba[4 * i + 1]) + " " +
+                               std::to_string(rgba[4 * i + 2]) + "\n";
+            _put(line.data(), line.size());
+        }
+        break;
+
+    case ImageFormat::TIFF:
+        _tiff->write_rows(rgba, n_rows);
+        break;
+
+    case ImageFormat::PNG:
+    case ImageFormat::GIF:
+    case ImageFormat::Y4M:
+        break;
+    }
+}
+
+void ImageWriter::flush() {
+    write_all(_fd, _buffer.data(), _buffer.size());
+    _buffer.clear();
+}
+
+void ImageWriter::_put(const void* data, size_t size) {
+    if (_buffer.size() + size > BUFFER_SIZE)
+        flush();
+
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    if (size >= BUFFER_SIZE) {
+        _buffer.assign(bytes, bytes + size);
+        flush();
+        return;
+    }
+    _buffer.insert(_buffer.end(), bytes, bytes + size);
+}
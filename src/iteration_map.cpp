@@ -0,0 +1,129 @@
+#include "iteration_map.hpp"
+#include "image_writer.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <limits>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr char MAGIC[8] = {'M', 'B', 'I', 'T', 'M', 'A', 'P', '1'};
+// Significant digits of the center, most of the header field.
+constexpr int CENTER_DIGITS = 60;
+
+void format_number(char* out, size_t size, long double value) {
+    std::snprintf(out, size, "%.*Le", std::numeric_limits<long double>::max_digits10, value);
+}
+
+// Mantissa bits of the values the kernel iterates per pixel.
+uint32_t kernel_precision(Mandelbrot::Kernel kernel) {
+    if (kernel == Mandelbrot::Kernel::PERTURBATION)
+        return std::numeric_limits<double>::digits;
+    return std::numeric_limits<long double>::digits;
+}
+
+} // namespace
+
+IterationMapWriter::IterationMapWriter(int fd, const Mandelbrot& mandelbrot, uint32_t precision_bits)
+    : _fd(fd), _header() {
+    std::copy_n(MAGIC, sizeof(MAGIC), _header.magic);
+    _header.width = mandelbrot.width;
+    _header.height = mandelbrot.frame_height;
+    _header.tile_size = TILE_SIZE;
+    _header.n_iter_max = mandelbrot.n_iter_max;
+    _header.precision_bits = precision_bits > 0 ? precision_bits : kernel_precision(mandelbrot.kernel);
+    std::snprintf(_header.center_real, sizeof(_header.center_real), "%s",
+                  format_coordinate(mandelbrot.center_point.real, CENTER_DIGITS).c_str());
+    std::snprintf(_header.center_imag, sizeof(_header.center_imag), "%s",
+                  format_coordinate(mandelbrot.center_point.imag, CENTER_DIGITS).c_str());
+    format_number(_header.magnification, sizeof(_header.magnification), mandelbrot.magnification);
+
+    write_all(_fd, reinterpret_cast<const uint8_t*>(&_header), sizeof(_header));
+
+    const uint32_t tiles_x = (_header.width + TILE_SIZE - 1) / TILE_SIZE;
+    _tile_rows.assign(size_t(tiles_x) * TILE_SIZE * TILE_SIZE, Mandelbrot::INTERIOR);
+}
+
+void IterationMapWriter::write_rows(const float* smooth, uint32_t y_start, uint32_t y_end) {
+    for (uint32_t y = y_start; y < y_end; y++) {
+        const float* row = smooth + size_t(y - y_start) * _header.width;
+        const uint32_t ty = y % TILE_SIZE;
+
+        for (uint32_t x = 0; x < _header.width; x += TILE_SIZE) {
+            uint32_t n = std::min(TILE_SIZE, _header.width - x);
+            float* tile = &_tile_rows[size_t(x / TILE_SIZE) * TILE_SIZE * TILE_SIZE];
+            std::copy_n(row + x, n, tile + size_t(ty) * TILE_SIZE);
+        }
+
+        if (++_rows_buffered == TILE_SIZE || y + 1 == _header.height)
+            _write_tile_row();
+    }
+}
+
+void IterationMapWriter::_write_tile_row() {
+    write_all(_fd, reinterpret_cast<const uint8_t*>(_tile_rows.data()), _tile_rows.size() * sizeof(float));
+    std::fill(_tile_rows.begin(), _tile_rows.end(), Mandelbrot::INTERIOR);
+    _rows_buffered = 0;
+}
+
+IterationMap::IterationMap(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw std::runtime_error("Cannot open " + path + ": " + std::strerror(errno));
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || size_t(info.st_size) < sizeof(IterationMapHeader)) {
+        ::close(fd);
+        throw std::runtime_error(path + " is not an iteration map");
+    }
+
+    _size = info.st_size;
+    _mapping = mmap(nullptr, _size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (_mapping == MAP_FAILED) {
+        _mapping = nullptr;
+        throw std::runtime_error("Cannot map " + path + ": " + std::strerror(errno));
+    }
+
+    header = static_cast<const IterationMapHeader*>(_mapping);
+    _values = reinterpret_cast<const float*>(header + 1);
+    _tiles_x = (header->width + header->tile_size - 1) / std::max(header->tile_size, 1U);
+
+    const uint32_t tiles_y = (header->height + header->tile_size - 1) / std::max(header->tile_size, 1U);
+    const size_t expected =
+        sizeof(IterationMapHeader) + size_t(_tiles_x) * tiles_y * header->tile_size * header->tile_size * sizeof(float);
+
+    if (std::memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0 || header->tile_size == 0 || _size < expected) {
+        munmap(_mapping, _size);
+        _mapping = nullptr;
+        throw std::runtime_error(path + " is not an iteration map or is truncated");
+    }
+
+    madvise(_mapping, _size, MADV_SEQUENTIAL);
+}
+
+IterationMap::~IterationMap() {
+    if (_mapping)
+        munmap(_mapping, _size);
+}
+
+void IterationMap::read_rows(uint32_t y_start, uint32_t y_end, float* out) const {
+    const uint32_t tile_size = header->tile_size;
+
+    for (uint32_t y = y_start; y < y_end; y++) {
+        const float* tile_row = _values + size_t(y / tile_size) * _tiles_x * tile_size * tile_size;
+        for (uint32_t x = 0; x < header->width; x += tile_size) {
+            uint32_t n = std::min(tile_size, header->width - x);
+            const float* tile = tile_row + size_t(x / tile_size) * tile_size * tile_size;
+            std::copy_n(tile + size_t(y % tile_size) * tile_size, n, out + x);
+        }
+        out += header->width;
+    }
+}
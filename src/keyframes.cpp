@@ -0,0 +1,154 @@
+#include "keyframes.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <future>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+
+namespace {
+
+// Checked before the engine allocates its buffers at the oversampled size.
+uint32_t oversampled_size(uint32_t size, float oversample) {
+    if (!(oversample >= 1.0f))
+        throw std::invalid_argument("Keyframes must not be smaller than the frames");
+    const float oversized = std::ceil(size * oversample);
+    if (!(oversized < float(std::numeric_limits<uint32_t>::max())))
+        throw std::invalid_argument("Keyframes are too large, use a smaller --oversample");
+    return uint32_t(oversized);
+}
+
+} // namespace
+
+KeyframeZoom::KeyframeZoom(uint32_t width, uint32_t height, const Complex& center, uint32_t n_iter_max,
+                           float oversample, ThreadPool& pool)
+    : _width(width), _height(height), _pool(pool),
+      _engine(oversampled_size(width, oversample), oversampled_size(height, oversample), pool) {
+    _engine.center_point = center;
+    _engine.n_iter_max = n_iter_max;
+}
+
+void KeyframeZoom::render(const std::vector<long double>& steps, AnimationOutput& output) {
+    _engine.kernel = kernel;
+    _engine.reserve_precision(steps.back());
+    if (auto_iterations > 0)
+        _engine.n_iter_max = 0;
+
+    // Keyframes from the target magnification down by factors of two, until
+    // the first frame is covered as well.
+    std::vector<long double> magnifications = {steps.back()};
+    while (magnifications.back() > steps.front())
+        magnifications.push_back(magnifications.back() / 2.0L);
+    std::reverse(magnifications.begin(), magnifications.end());
+
+    Keyframe outer, inner;
+    size_t next_keyframe = 0;
+    _render_keyframe(outer, magnifications[next_keyframe++], output);
+    if (next_keyframe < magnifications.size())
+        _render_keyframe(inner, magnifications[next_keyframe++], output);
+
+    for (size_t i = 0; i < steps.size(); i++) {
+        while (inner.magnification > 0.0L && steps[i] > inner.magnification) {
+            std::swap(outer, inner);
+            inner.magnification = 0.0L;
+            if (next_keyframe < magnifications.size())
+                _render_keyframe(inner, magnifications[next_keyframe++], output);
+        }
+
+        std::cerr << "\r[INFO] Synthesizing frame " << i + 1 << " of " << steps.size() << "  |  Magnification "
+                  << steps[i] << "   " << std::flush;
+
+        _synthesize(outer, inner.magnification > 0.0L ? &inner : nullptr, steps[i], output);
+        output.commit();
+    }
+}
+
+void KeyframeZoom::_render_keyframe(Keyframe& keyframe, long double magnification, AnimationOutput& output) {
+    std::cerr << "\r[INFO] Rendering keyframe  |  Magnification " << magnification << "   " << std::flush;
+
+    const size_t n_pixels = size_t(_engine.width) * _engine.height;
+    if (output.indexed())
+        keyframe.indices.resize(n_pixels);
+    else
+        keyframe.rgba.resize(n_pixels * Colorizer::RGBA_SIZE);
+
+    _engine.magnification = magnification;
+    _engine.has_changed = true;
+    if (auto_iterations > 0)
+        _engine.n_iter_max = _engine.choose_iterations(auto_iterations, _engine.n_iter_max);
+    _engine.update([&](uint32_t y_start, uint32_t y_end) {
+        const size_t first = size_t(y_start) * _engine.width;
+        const size_t count = size_t(y_end - y_start) * _engine.width;
+        if (output.indexed())
+            Colorizer::gradient_indices(_engine.smooth + first, keyframe.indices.data() + first, count,
+                                        output.coloring);
+        else
+            Colorizer::colorize(_engine.smooth + first, keyframe.rgba.data() + first * Colorizer::RGBA_SIZE, count,
+                                output.coloring);
+    });
+
+    keyframe.magnification = magnification;
+}
+
+void KeyframeZoom::_synthesize(const Keyframe& outer, const Keyframe* inner, long double magnification,
+                               AnimationOutput& output) {
+    const uint32_t key_width = _engine.width;
+    const uint32_t key_height = _engine.height;
+
+    // Frame pixel (x, y) lies at (x - width / 2) * scale + key_width / 2 in a
+    // keyframe, the same pixel convention as `Mandelbrot::update`.
+    const double outer_scale = double(outer.magnification / magnification) * key_width / _width;
+    const double inner_scale = inner ? double(inner->magnification / magnification) * key_width / _width : 0.0;
+
+    auto sample_rows = [&](uint32_t y_start, uint32_t y_end) {
+        for (uint32_t y = y_start; y < y_end; y++) {
+            for (uint32_t x = 0; x < _width; x++) {
+                const Keyframe* source = &outer;
+                double scale = outer_scale;
+                double kx = (x - _width / 2.0) * inner_scale + key_width / 2.0;
+                double ky = (y - _height / 2.0) * inner_scale + key_height / 2.0;
+
+                if (!inner || kx < 0 || ky < 0 || kx > key_width - 1 || ky > key_height - 1) {
+                    kx = std::clamp((x - _width / 2.0) * scale + key_width / 2.0, 0.0, key_width - 1.0);
+                    ky = std::clamp((y - _height / 2.0) * scale + key_height / 2.0, 0.0, key_height - 1.0);
+                }
+                else {
+                    source = inner;
+                }
+
+                const size_t i = size_t(y) * _width + x;
+
+                // Gradient indices can not be blended, they take the nearest pixel.
+                if (output.indexed()) {
+                    output.indices()[i] = source->indices[size_t(ky + 0.5) * key_width + size_t(kx + 0.5)];
+                    continue;
+                }
+
+                const uint32_t x0 = std::min<uint32_t>(kx, key_width - 2);
+                const uint32_t y0 = std::min<uint32_t>(ky, key_height - 2);
+                const double fx = kx - x0, fy = ky - y0;
+                const uint8_t* p00 = &source->rgba[(size_t(y0) * key_width + x0) * Colorizer::RGBA_SIZE];
+                const uint8_t* p10 = p00 + Colorizer::RGBA_SIZE;
+                const uint8_t* p01 = p00 + size_t(key_width) * Colorizer::RGBA_SIZE;
+                const uint8_t* p11 = p01 + Colorizer::RGBA_SIZE;
+
+                uint8_t* pixel = output.rgba() + i * Colorizer::RGBA_SIZE;
+                for (int c = 0; c < Colorizer::RGBA_SIZE; c++) {
+                    double top = p00[c] + (p10[c] - p00[c]) * fx;
+                    double bottom = p01[c] + (p11[c] - p01[c]) * fx;
+                    pixel[c] = uint8_t(top + (bottom - top) * fy + 0.5);
+                }
+            }
+        }
+    };
+
+    const uint32_t n_chunks = _pool.size() * 4;
+    const uint32_t rows_per_chunk = (_height + n_chunks - 1) / n_chunks;
+    std::vector<std::future<void>> futures;
+
+    for (uint32_t y = 0; y < _height; y += rows_per_chunk)
+        futures.push_back(_pool.submit([&, y]() { sample_rows(y, std::min(y + rows_per_chunk, _height)); }));
+    for (auto& future : futures)
+        future.get();
+}
@@ -0,0 +1,169 @@
+#include "logpolar.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <future>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+constexpr double TWO_PI = 6.28318530717958647692528676655900576839433879875021;
+
+} // namespace
+
+LogPolarZoom::LogPolarZoom(uint32_t width, uint32_t height, const Complex& center, uint32_t n_iter_max,
+                           uint32_t strip_width, ThreadPool& pool)
+    : _width(width), _height(height), _pool(pool), _center(center), _n_iter_max(n_iter_max) {
+    // The outermost ring of a frame is its circumcircle, which needs about as
+    // many angles as it has pixels along its circumference.
+    _strip_width = strip_width > 0 ? strip_width : uint32_t(std::ceil(M_PI * std::hypot(width, height)));
+}
+
+void LogPolarZoom::render(const std::vector<long double>& steps, AnimationOutput& output) {
+    // From the corners of the first frame down to half a pixel of the last one.
+    const long double radius = 2.0L / steps.front() * std::hypot(1.0L, (long double)_height / _width);
+    const long double min_radius = 2.0L / steps.back() / _width;
+    const uint32_t strip_height = uint32_t(std::ceil(logl(radius / min_radius) * _strip_width / TWO_PI)) + 2;
+    const double rows_per_log = _strip_width / TWO_PI;
+
+    // A frame reads the rings from its corners down to half a pixel, plus one
+    // row to blend. If the strip exceeds the memory budget it is computed in
+    // blocks of rows: the engine holds one block, the colors two consecutive
+    // ones, so every frame lies within them.
+    const uint32_t frame_rows = uint32_t(std::ceil(std::log(std::hypot(_width, _height)) * rows_per_log)) + 3;
+    const size_t color_size = size_t(_strip_width) * (output.indexed() ? sizeof(uint16_t) : Colorizer::RGBA_SIZE);
+    const size_t engine_size = size_t(_strip_width) * (sizeof(uint32_t) + sizeof(float));
+    const bool whole = strip_height * (engine_size + color_size) <= memory;
+    const size_t block_size = engine_size + 2 * color_size; // Per row of a block
+    const uint32_t block_rows = whole ? strip_height : uint32_t(std::min<size_t>(strip_height, memory / block_size));
+    if (!whole && block_rows < frame_rows)
+        throw std::invalid_argument("The log-polar strip needs --memory=" +
+                                    std::to_string((frame_rows * block_size >> 20) + 1) + " at least");
+
+    std::cerr << "[INFO] Rendering log-polar strip of " << _strip_width << "x" << strip_height;
+    if (block_rows < strip_height)
+        std::cerr << " in blocks of " << block_rows << " rows";
+    std::cerr << std::endl;
+
+    Mandelbrot strip(_strip_width, block_rows, _pool);
+    strip.center_point = _center;
+    strip.n_iter_max = _n_iter_max;
+    strip.kernel = kernel;
+    strip.log_polar = true;
+    strip.polar_radius = radius;
+    strip.frame_height = strip_height;
+
+    const size_t block_pixels = size_t(_strip_width) * block_rows;
+    const size_t n_halves = whole ? 1 : 2;
+    std::vector<uint8_t> rgba;
+    std::vector<uint16_t> indices;
+    if (output.indexed())
+        indices.resize(n_halves * block_pixels);
+    else
+        rgba.resize(n_halves * block_pixels * Colorizer::RGBA_SIZE);
+
+    // Colors block `block` of the strip into the first or second half.
+    auto render_block = [&](uint32_t block, size_t half) {
+        if (size_t(block) * block_rows >= strip_height)
+            return;
+        strip.row_offset = block * block_rows;
+        strip.has_changed = true;
+        strip.update([&](uint32_t y_start, uint32_t y_end) {
+            const size_t first = size_t(y_start) * _strip_width;
+            const size_t count = size_t(y_end - y_start) * _strip_width;
+            const size_t out = half * block_pixels + first;
+            if (output.indexed())
+                Colorizer::gradient_indices(strip.smooth + first, indices.data() + out, count, output.coloring);
+            else
+                Colorizer::colorize(strip.smooth + first, rgba.data() + out * Colorizer::RGBA_SIZE, count,
+                                    output.coloring);
+        });
+    };
+
+    int64_t first_block = -2; // Blocks held in the two halves are first_block and first_block + 1
+    for (size_t i = 0; i < steps.size(); i++) {
+        const double pixel = double(4.0L / steps[i] / _width / radius);
+        const double corner_row = -std::log(std::hypot(_width, _height) / 2.0 * pixel) * rows_per_log;
+        const uint32_t block = uint32_t(std::max(0.0, std::floor(corner_row) - 1.0)) / block_rows;
+
+        if (block == first_block + 1) {
+            std::copy(rgba.begin() + rgba.size() / 2, rgba.end(), rgba.begin());
+            std::copy(indices.begin() + indices.size() / 2, indices.end(), indices.begin());
+            render_block(block + 1, 1);
+        }
+        else if (block != first_block) {
+            render_block(block, 0);
+            render_block(block + 1, 1);
+        }
+        first_block = block;
+
+        std::cerr << "\r[INFO] Warping frame " << i + 1 << " of " << steps.size() << "  |  Magnification "
+                  << steps[i] << "   " << std::flush;
+
+        _warp(rgba, indices, size_t(block) * block_rows, strip_height, radius, steps[i], output);
+        output.commit();
+    }
+}
+
+void LogPolarZoom::_warp(const std::vector<uint8_t>& rgba, const std::vector<uint16_t>& indices, size_t first_row,
+                         uint32_t strip_height, long double radius, long double magnification,
+                         AnimationOutput& output) {
+    // Pixel size of the frame relative to the outermost ring, in log space
+    // only this offset changes from frame to frame.
+    const double pixel = double(4.0L / magnification / _width / radius);
+    const double rows_per_log = _strip_width / TWO_PI;
+
+    // The center pixel takes the ring at half a pixel, the rows held end shortly after.
+    const double last_row = std::min(-std::log(0.5 * pixel) * rows_per_log, strip_height - 1.001);
+
+    auto warp_rows = [&](uint32_t y_start, uint32_t y_end) {
+        for (uint32_t y = y_start; y < y_end; y++) {
+            for (uint32_t x = 0; x < _width; x++) {
+                // Same pixel convention as `Mandelbrot::update`.
+                const double dx = (x - _width / 2.0) * pixel;
+                const double dy = (_height / 2.0 - y) * pixel;
+
+                double row = -std::log(std::max(std::hypot(dx, dy), 1e-300)) * rows_per_log;
+                double column = std::atan2(dy, dx) / TWO_PI * _strip_width;
+                row = std::clamp(row, 0.0, last_row) - first_row;
+                if (column < 0)
+                    column += _strip_width;
+
+                const size_t i = size_t(y) * _width + x;
+
+                // Gradient indices can not be blended, they take the nearest pixel.
+                if (output.indexed()) {
+                    size_t c = size_t(column + 0.5) % _strip_width;
+                    output.indices()[i] = indices[size_t(row + 0.5) * _strip_width + c];
+                    continue;
+                }
+
+                const uint32_t r0 = uint32_t(row), c0 = uint32_t(column) % _strip_width;
+                const uint32_t c1 = (c0 + 1) % _strip_width;
+                const double fr = row - r0, fc = column - std::floor(column);
+                const uint8_t* p00 = &rgba[(size_t(r0) * _strip_width + c0) * Colorizer::RGBA_SIZE];
+                const uint8_t* p01 = &rgba[(size_t(r0) * _strip_width + c1) * Colorizer::RGBA_SIZE];
+                const uint8_t* p10 = p00 + size_t(_strip_width) * Colorizer::RGBA_SIZE;
+                const uint8_t* p11 = p01 + size_t(_strip_width) * Colorizer::RGBA_SIZE;
+
+                uint8_t* pixel_out = output.rgba() + i * Colorizer::RGBA_SIZE;
+                for (int c = 0; c < Colorizer::RGBA_SIZE; c++) {
+                    double outer = p00[c] + (p01[c] - p00[c]) * fc;
+                    double inner = p10[c] + (p11[c] - p10[c]) * fc;
+                    pixel_out[c] = uint8_t(outer + (inner - outer) * fr + 0.5);
+                }
+            }
+        }
+    };
+
+    const uint32_t n_chunks = _pool.size() * 4;
+    const uint32_t rows_per_chunk = (_height + n_chunks - 1) / n_chunks;
+    std::vector<std::future<void>> futures;
+
+    for (uint32_t y = 0; y < _height; y += rows_per_chunk)
+        futures.push_back(_pool.submit([&, y]() { warp_rows(y, std::min(y + rows_per_chunk, _height)); }));
+    for (auto& future : futures)
+        future.get();
+}
@@ -0,0 +1,69 @@
+#include "lru_tile_cache.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+size_t LruTileCache::KeyHash::operator()(const TileKey& key) const {
+    return hash_tile_key(key);
+}
+
+bool LruTileCache::KeyEqual::operator()(const TileKey& a, const TileKey& b) const {
+    return a == b;
+}
+
+LruTileCache::LruTileCache(size_t budget, TileStore* next)
+    : _next(next), _max_tiles(std::max<size_t>(1, budget / sizeof(Entry))) {
+    _index.reserve(_max_tiles);
+}
+
+bool LruTileCache::lookup(const TileKey& key, uint32_t* iterations, float* smooth) {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        auto found = _index.find(key);
+        if (found != _index.end()) {
+            _entries.splice(_entries.begin(), _entries, found->second);
+            const uint8_t* data = found->second->data.data();
+            std::memcpy(iterations, data, TILE_PIXELS * sizeof(uint32_t));
+            std::memcpy(smooth, data + TILE_PIXELS * sizeof(uint32_t), TILE_PIXELS * sizeof(float));
+            return true;
+        }
+    }
+
+    if (_next == nullptr || !_next->lookup(key, iterations, smooth))
+        return false;
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _store(key, iterations, smooth);
+    return true;
+}
+
+void LruTileCache::insert(const TileKey& key, const uint32_t* iterations, const float* smooth) {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _store(key, iterations, smooth);
+    }
+
+    if (_next != nullptr)
+        _next->insert(key, iterations, smooth);
+}
+
+void LruTileCache::_store(const TileKey& key, const uint32_t* iterations, const float* smooth) {
+    if (_index.count(key) != 0)
+        return;
+
+    // Reuse the least recently used entry once the budget is reached.
+    if (_index.size() >= _max_tiles) {
+        _index.erase(_entries.back().key);
+        _entries.splice(_entries.begin(), _entries, std::prev(_entries.end()));
+    }
+    else {
+        _entries.emplace_front();
+    }
+
+    Entry& entry = _entries.front();
+    entry.key = key;
+    std::memcpy(entry.data.data(), iterations, TILE_PIXELS * sizeof(uint32_t));
+    std::memcpy(entry.data.data() + TILE_PIXELS * sizeof(uint32_t), smooth, TILE_PIXELS * sizeof(float));
+    _index[key] = _entries.begin();
+}
@@ -1,62 +1,159 @@
-#include <SFML/Graphics.hpp>
+#include <cstdint>
+#include <exception>
 #include <iostream>
-#include <sstream>
+#include <memory>
 
+#include "export.hpp"
+#include "lru_tile_cache.hpp"
 #include "mandelbrot.hpp"
+#include "options.hpp"
+#include "perf_counters.hpp"
+#include "reference_orbit.hpp"
+#include "thread_pool.hpp"
+#include "tile_cache.hpp"
+#include "trace.hpp"
+
+#ifndef MANDELBROT_HEADLESS
+#include "preview_pyramid.hpp"
 #include "renderer.hpp"
 
-void interactive_mode(const uint16_t screen_width, const uint16_t screen_height) {
+#include <chrono>
+
+// How often partial frames are presented while computing.
+constexpr std::chrono::milliseconds PROGRESS_INTERVAL(33);
+
+void interactive_mode(const uint16_t screen_width, const uint16_t screen_height, const Options& options,
+                      const PerfCounters* counters) {
     std::cout << "[INFO] Interactive mode started ... \n";
 
+    // Recently visited tiles are kept in memory, in front of the optional
+    // persistent cache. Going back to a view only costs the lookups.
+    std::unique_ptr<TileCache> cache = open_tile_cache(options);
+    std::unique_ptr<LruTileCache> memory;
+    if (size_t budget = std::stoull(options.get("tile-memory", "256")) << 20; budget > 0)
+        memory = std::make_unique<LruTileCache>(budget, cache.get());
+
+    PreviewPyramid preview;
     Mandelbrot mandelbrot(screen_width, screen_height);
+    mandelbrot.tile_cache = memory ? memory.get() : static_cast<TileStore*>(cache.get());
+    mandelbrot.preview = &preview;
+    mandelbrot.kernel = Mandelbrot::parse_kernel(options.get("kernel", "direct"));
+    if (options.has("auto-iterations"))
+        mandelbrot.auto_iterations = Renderer::MAX_ITERATIONS;
     Renderer renderer(mandelbrot.width, mandelbrot.height);
 
+    // Opened on this thread, the stages run on it.
+    std::unique_ptr<PerfCounters> main_counters;
+    if (counters != nullptr)
+        main_counters = std::make_unique<PerfCounters>(std::stoull(options.get("perf-raw", "0"), nullptr, 0),
+                                                       PerfCounters::Target::THREAD);
+    renderer.timing.set_counters(counters, main_counters.get(), uint64_t(mandelbrot.width) * mandelbrot.height);
+
     while (renderer.window.isOpen()) {
         renderer.check_events(renderer.window, mandelbrot);
-        mandelbrot.update();
+
+        if (mandelbrot.has_changed) {
+            FrameTimer::Scope compute(renderer.timing, FrameTimer::Stage::COMPUTE);
+
+            // The last frame resampled to the new view is shown right away,
+            // exact rows replace it as they are finished. Keys pressed in the
+            // meantime cancel the frame and start over with the new view.
+            if (preview.resample(mandelbrot.center_point, mandelbrot.magnification, mandelbrot.width,
+                                 mandelbrot.height, mandelbrot.smooth)) {
+                renderer.update_rows(mandelbrot, 0, mandelbrot.height);
+                renderer.show();
+            }
+
+            auto last_shown = std::chrono::steady_clock::now();
+            mandelbrot.update([&](uint32_t y_start, uint32_t y_end) {
+                renderer.update_rows(mandelbrot, y_start, y_end);
+                if (std::chrono::steady_clock::now() - last_shown < PROGRESS_INTERVAL)
+                    return;
+
+                renderer.show();
+                renderer.check_events(renderer.window, mandelbrot);
+                if (mandelbrot.has_changed || !renderer.window.isOpen())
+                    mandelbrot.cancel();
+                last_shown = std::chrono::steady_clock::now();
+            });
+        }
+
         renderer.update(&mandelbrot);
         renderer.show();
+        renderer.timing.end_frame();
+    }
+
+    if (options.has("timings") || counters != nullptr) {
+        std::cerr << "[INFO] Frame timings of the last " << FrameTimer::CAPACITY << " frames:\n";
+        renderer.timing.report(std::cerr);
     }
 
     std::cout << "[INFO] Interactive mode terminated." << std::endl;
 }
+#else
+void interactive_mode(const uint16_t, const uint16_t, const Options&, const PerfCounters*) {
+    std::cerr << "[ERROR] Interactive mode is not available in headless builds." << std::endl;
+}
+#endif
 
-void export_frame(char* argv[]) {
-    Mandelbrot mandelbrot(std::stoi(argv[1]), std::stoi(argv[2]));
+int main(int argc, char* argv[]) {
+    Options options(argc, argv);
 
-    mandelbrot.center_point.real = std::stold(argv[3]);
-    mandelbrot.center_point.imag = std::stold(argv[4]);
-    mandelbrot.n_iter_max = std::stoi(argv[5]);
-    mandelbrot.magnification = std::stold(argv[6]);
+    if (options.has("trace")) {
+        Trace::shared().set_thread_name("Main");
+        Trace::shared().enable();
+    }
 
-    // Calculate Mandelbrot and pixel colors
-    // TODO: Make color function as a static function to get rid of Renderer instance
-    Renderer renderer(mandelbrot.width, mandelbrot.height);
-    mandelbrot.update();
-    renderer.update(&mandelbrot);
+    std::unique_ptr<PerfCounters> counters;
+    int status = 0;
+    try {
+        // Before the first use of the thread pool, so the workers are counted.
+        if (options.has("perf"))
+            counters = std::make_unique<PerfCounters>(std::stoull(options.get("perf-raw", "0"), nullptr, 0));
+
+        ThreadPool::set_shared_size(std::stoul(options.get("threads", "0")));
 
-    // Output as ppm format to stdout, to be further process by scripts.
-    std::ostringstream oss;
+        if (options.has("orbit-cache"))
+            OrbitCache::shared().set_directory(options.get("orbit-cache", ""));
 
-    oss << "P3\n" << mandelbrot.width << "\n" << mandelbrot.height << "\n255\n";
-    for (size_t i = 0; i < mandelbrot.width * mandelbrot.height; i++) {
-        oss << (int)renderer.pixels[4 * i + 0] << " " << (int)renderer.pixels[4 * i + 1] << " "
-            << (int)renderer.pixels[4 * i + 2] << "\n";
+        if (options.has("recolor")) {
+            recolor(options);
+        }
+        else {
+            switch (options.positional.size()) {
+            case 0:
+                interactive_mode(1280, 720, options, counters.get());
+                break;
+            case 2:
+                interactive_mode(std::stoi(options.positional[0]), std::stoi(options.positional[1]), options,
+                                 counters.get());
+                break;
+            case 6:
+                if (options.has("animate"))
+                    export_animation(options);
+                else
+                    export_frame(options);
+                break;
+            default:
+                std::cerr << "[ERROR] Unexpected number of arguments, see README.md for usage." << std::endl;
+                status = 1;
+            }
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << "[ERROR] " << e.what() << std::endl;
+        status = 1;
     }
-    std::cout << oss.str();
-};
 
-int main(int argc, char* argv[]) {
-    switch (argc) {
-    case 1:
-        interactive_mode(1280, 720);
-        break;
-    case 3:
-        interactive_mode(std::stoi(argv[1]), std::stoi(argv[2]));
-        break;
-    case 7:
-        export_frame(argv);
-        break;
+    // Also after errors, the timeline may show what went wrong.
+    if (options.has("trace")) {
+        try {
+            Trace::shared().write(options.get("trace", ""));
+        }
+        catch (const std::exception& e) {
+            std::cerr << "[ERROR] " << e.what() << std::endl;
+            status = 1;
+        }
     }
-    return 0;
+    return status;
 }
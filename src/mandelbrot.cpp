@@ -1,78 +1,468 @@
 #include "mandelbrot.hpp"
-#include <SFML/Graphics.hpp>
+#include "preview_pyramid.hpp"
+#include "reference_orbit.hpp"
+#include "tile_cache.hpp"
+#include "trace.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cmath>
+#include <condition_variable>
 #include <future>
 #include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+int64_t floor_div(int64_t value, int64_t divisor) {
+    return value >= 0 ? value / divisor : -((-value + divisor - 1) / divisor);
+}
+
+// Exact, gmpxx has no long double operators.
+mpf_class from_long_double(long double value, mp_bitcnt_t precision) {
+    double high = double(value);
+    return mpf_class(mpf_class(high, precision) + double(value - high), precision);
+}
+
+// Points in the main cardioid and the period 2 bulb never escape.
+bool inside_main_bulbs(long double c_real, long double c_imag) {
+    const long double q = (c_real - 0.25L) * (c_real - 0.25L) + c_imag * c_imag;
+    return q * (q + c_real - 0.25L) <= 0.25L * c_imag * c_imag ||
+           (c_real + 1.0L) * (c_real + 1.0L) + c_imag * c_imag <= 0.0625L;
+}
+
+} // namespace
 
-Mandelbrot::Mandelbrot(const uint32_t width, const uint32_t height) : width(width), height(height) {
-    iterations = new uint32_t[width * height];
-    real_parts = new long double[width * height];
-    imag_parts = new long double[width * height];
+Mandelbrot::Mandelbrot(const uint32_t width, const uint32_t height, ThreadPool& pool)
+    : width(width), height(height), frame_height(height), _pool(pool) {
+    iterations = new uint32_t[size_t(width) * height];
+    smooth = new float[size_t(width) * height];
 };
 
+Mandelbrot::~Mandelbrot() {
+    delete[] iterations;
+    delete[] smooth;
+}
+
 void Mandelbrot::update() {
     if (!has_changed)
         return;
 
-    // Determine the real (x) and imag(y) values based on the center coordinate
-    // and magnification. The delta values are used to iterate over all pixel and
-    // simply add the delta.
-    _real_start = -2.0 / magnification + center_point.real;
-    _imag_start = 2.0 / magnification * height / width + center_point.imag;
-    _delta_real = 4.0 / magnification / width;
-    _delta_imag = -4.0 / magnification / width;
+    update([](uint32_t, uint32_t) {});
+}
+
+void Mandelbrot::update(const std::function<void(uint32_t y_start, uint32_t y_end)>& on_rows) {
+    // Determine the offsets of the first pixel from the center coordinate
+    // based on the magnification. The delta values are used to iterate over
+    // all pixel and simply add the delta.
+    const auto start_time = std::chrono::steady_clock::now();
+    // Strips of a frame share the limit of the first one.
+    if (auto_iterations > 0 && row_offset == 0)
+        n_iter_max = choose_iterations(auto_iterations);
+    Trace::Span frame_span("Frame", "frame", "n_iter_max", n_iter_max);
+    _center = center_point;
+    _center_real = to_long_double(_center.real);
+    _center_imag = to_long_double(_center.imag);
+    _magnification = magnification;
+    _n_iter_max = n_iter_max;
+    _kernel = kernel;
+    _cancelled = false;
+    has_changed = false;
+
+    // The offsets round like the products with the delta, so the center row
+    // and column are exactly on the center.
+    _delta_real = 4.0 / _magnification / width;
+    _delta_imag = -4.0 / _magnification / width;
+    _offset_real = -_delta_real * (width / 2.0L);
+    _offset_imag = -_delta_imag * (frame_height / 2.0L);
+
+    // The reference is computed with at least the precision of the center,
+    // so all frames of a zoom share one orbit.
+    if (_kernel == Kernel::PERTURBATION) {
+        mp_bitcnt_t precision = std::max(precision_bits(_magnification, width), _center.real.get_prec());
+        _orbit = OrbitCache::shared().get(_center, _n_iter_max, precision);
+    }
+
+    // Snap to the grid, as long as the grid position is exact. The position
+    // of the first pixel on the grid is computed in full precision.
+    _origin_x = _origin_y = 0;
+    _band_phase = 0;
+    const mp_bitcnt_t grid_precision = _center.real.get_prec() + 64;
+    mpf_class grid_x(_center.real / from_long_double(_delta_real, grid_precision) - width / 2.0, grid_precision);
+    mpf_class grid_y(_center.imag / from_long_double(_delta_imag, grid_precision) - frame_height / 2.0,
+                     grid_precision);
+    const bool use_cache = tile_cache != nullptr && !log_polar && abs(grid_x) < 0x1p62 && abs(grid_y) < 0x1p62;
+    if (use_cache) {
+        _origin_x = mpf_class(floor(grid_x + 0.5)).get_si();
+        _origin_y = mpf_class(floor(grid_y + 0.5)).get_si();
+        _offset_real += mpf_class(_origin_x - grid_x).get_d() * _delta_real;
+        _offset_imag += mpf_class(_origin_y - grid_y).get_d() * _delta_imag;
+
+        const int64_t first_row = _origin_y + row_offset;
+        _band_phase = uint32_t(first_row - floor_div(first_row, BAND_HEIGHT) * BAND_HEIGHT);
+    }
+
+    const unsigned int num_threads = _pool.size();
+    const uint32_t n_rows = std::min(height, frame_height - row_offset);
 
-    unsigned int num_threads = std::thread::hardware_concurrency();
-    if (num_threads == 0)
-        num_threads = 2;
+    // Bands are pulled dynamically, so expensive regions do not stall a single
+    // worker. Finished bands are reported in order to `on_rows`. With a cache
+    // the bands follow the grid, so the first one may be shorter.
+    const uint32_t n_bands = (n_rows + _band_phase + BAND_HEIGHT - 1) / BAND_HEIGHT;
+    auto band_rows = [&](uint32_t band) {
+        uint32_t y_start = std::max(band * BAND_HEIGHT, _band_phase) - _band_phase;
+        return std::make_pair(y_start, std::min((band + 1) * BAND_HEIGHT - _band_phase, n_rows));
+    };
+    std::atomic<uint32_t> next_band = 0;
+    std::vector<bool> band_done(n_bands, false);
+    std::mutex mutex;
+    std::condition_variable band_finished;
+
+    _worker_stats.assign(num_threads, WorkerStats());
+    _frame_stats = FrameStats(_n_iter_max);
+
+    _tile_x0 = use_cache ? floor_div(_origin_x, TILE_WIDTH) * TILE_WIDTH - _origin_x : 0;
+    _n_tile_columns = uint32_t((width - _tile_x0 + TILE_WIDTH - 1) / TILE_WIDTH);
+    _tile_times.assign(size_t(n_bands) * _n_tile_columns, 0.0f);
+
+    auto worker = [&](WorkerStats& stats) {
+        FrameStats frame_stats(_n_iter_max);
+        for (uint32_t band = next_band++; band < n_bands && !_cancelled; band = next_band++) {
+            auto [y_start, y_end] = band_rows(band);
+            Trace::Span span(use_cache ? "Tiles" : "Chunk", "band", "row", row_offset + y_start);
+            const auto band_start = std::chrono::steady_clock::now();
+            stats.iterations += use_cache ? _calculate_tiles(y_start, y_end, frame_stats)
+                                          : _calculate_chunk(y_start, y_end, frame_stats);
+            stats.pixels += size_t(y_end - y_start) * width;
+            stats.busy_time += std::chrono::duration<double>(std::chrono::steady_clock::now() - band_start).count();
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                band_done[band] = true;
+            }
+            band_finished.notify_one();
+        }
+
+        // Wake up the wait below in case it waits for a band skipped after `cancel`.
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            _frame_stats.merge(frame_stats);
+        }
+        band_finished.notify_one();
+    };
 
     std::vector<std::future<void>> futures;
-    uint32_t rows_per_thread = height / num_threads;
+    for (size_t i = 0; i < num_threads; i++)
+        futures.push_back(_pool.submit([&, i]() { worker(_worker_stats[i]); }));
 
-    for (size_t i = 0; i < num_threads; i++) {
-        uint32_t start_y = i * rows_per_thread;
-        uint32_t end_y = (i == num_threads - 1) ? height : (i + 1) * rows_per_thread;
+    try {
+        for (uint32_t band = 0; band < n_bands && !_cancelled; band++) {
+            bool done;
+            {
+                Trace::Span span("Wait", "frame", "band", band);
+                std::unique_lock<std::mutex> lock(mutex);
+                band_finished.wait(lock, [&]() { return band_done[band] || _cancelled; });
+                done = band_done[band];
+            }
+            if (!done)
+                break;
+            auto [y_start, y_end] = band_rows(band);
+            on_rows(y_start, y_end);
+        }
+    }
+    catch (...) {
+        // The workers still reference the locals above, let them drain first.
+        next_band = n_bands;
+        for (auto& future : futures)
+            future.wait();
+        has_changed = true;
+        throw;
+    }
 
-        futures.push_back(std::async(std::launch::async, &Mandelbrot::_calculate_chunk, this, start_y, end_y));
+    for (auto& future : futures)
+        future.get();
+
+    frame_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+    for (WorkerStats& stats : _worker_stats)
+        stats.idle_time = std::max(0.0, frame_time - stats.busy_time);
+    if (_cancelled) {
+        Trace::shared().instant("Cancelled", "cancel");
+        has_changed = true;
+        return;
     }
+    if (preview != nullptr && row_offset == 0 && n_rows == frame_height)
+        preview->store(smooth, width, height, _center, _magnification);
+}
 
-    has_changed = false;
+void Mandelbrot::cancel() {
+    Trace::shared().instant("Cancel", "cancel");
+    _cancelled = true;
+}
+
+const std::vector<Mandelbrot::WorkerStats>& Mandelbrot::worker_stats() const {
+    return _worker_stats;
+}
+
+const Mandelbrot::FrameStats& Mandelbrot::frame_stats() const {
+    return _frame_stats;
+}
+
+Mandelbrot::FrameStats::FrameStats(uint32_t n_iter_max) : n_iter_max(n_iter_max) {
+    while (n_iter_max > 0 && (n_iter_max - 1) >> bin_shift >= HISTOGRAM_BINS)
+        bin_shift++;
+}
+
+void Mandelbrot::FrameStats::merge(const FrameStats& other) {
+    pixels += other.pixels;
+    escaped += other.escaped;
+    escaped_iterations += other.escaped_iterations;
+    min_iterations = std::min(min_iterations, other.min_iterations);
+    max_iterations = std::max(max_iterations, other.max_iterations);
+    for (uint32_t i = 0; i < HISTOGRAM_BINS; i++)
+        histogram[i] += other.histogram[i];
 }
 
-void Mandelbrot::_calculate_chunk(uint32_t y_start, uint32_t y_end) {
-    for (uint32_t y = y_start; y < y_end; y++) {
-        for (uint32_t x = 0; x < width; x++) {
-            _base_algorithm(x, y);
+double Mandelbrot::imbalance() const {
+    double max_busy = 0.0, total_busy = 0.0;
+    for (const WorkerStats& stats : _worker_stats) {
+        max_busy = std::max(max_busy, stats.busy_time);
+        total_busy += stats.busy_time;
+    }
+    return total_busy > 0.0 ? max_busy * _worker_stats.size() / total_busy : 1.0;
+}
+
+double Mandelbrot::tile_time(uint32_t x, uint32_t y) const {
+    const size_t i = size_t((y + _band_phase) / BAND_HEIGHT) * _n_tile_columns + size_t((x - _tile_x0) / TILE_WIDTH);
+    return i < _tile_times.size() ? _tile_times[i] : 0.0;
+}
+
+uint64_t Mandelbrot::_calculate_chunk(uint32_t y_start, uint32_t y_end, FrameStats& stats) {
+    float* tile_times = _tile_times.data() + size_t(y_start / BAND_HEIGHT) * _n_tile_columns;
+    uint64_t n_iterations = 0;
+    for (uint32_t x_start = 0; x_start < width; x_start += TILE_WIDTH) {
+        const auto start = std::chrono::steady_clock::now();
+        const uint32_t x_end = std::min(x_start + TILE_WIDTH, width);
+        for (uint32_t y = y_start; y < y_end; y++) {
+            for (uint32_t x = x_start; x < x_end; x++) {
+                n_iterations += _base_algorithm(x, y, stats);
+            }
+        }
+        tile_times[x_start / TILE_WIDTH] =
+            std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count();
+    }
+    return n_iterations;
+}
+
+uint64_t Mandelbrot::_calculate_tiles(uint32_t y_start, uint32_t y_end, FrameStats& stats) {
+    static_assert(TileStore::TILE_HEIGHT == BAND_HEIGHT, "Tiles are computed band by band");
+    static_assert(TileStore::TILE_WIDTH == TILE_WIDTH, "Tile times are kept per cached tile");
+
+    const int64_t first_row = _origin_y + row_offset;
+    const int64_t tile_y = floor_div(first_row + y_start, BAND_HEIGHT);
+
+    TileKey key = make_tile_key(_delta_real, _n_iter_max, uint32_t(_kernel));
+    key.y = tile_y;
+
+    uint32_t tile_iterations[TileStore::TILE_PIXELS];
+    float tile_smooth[TileStore::TILE_PIXELS];
+    uint64_t n_iterations = 0;
+
+    const int64_t first_column = floor_div(_origin_x, TILE_WIDTH);
+    float* tile_times = _tile_times.data() + size_t((y_start + _band_phase) / BAND_HEIGHT) * _n_tile_columns;
+
+    for (key.x = first_column; key.x * TILE_WIDTH < _origin_x + width; key.x++) {
+        const auto start = std::chrono::steady_clock::now();
+        if (!tile_cache->lookup(key, tile_iterations, tile_smooth)) {
+            for (uint32_t ty = 0; ty < BAND_HEIGHT; ty++) {
+                long double dc_imag = _offset_imag + _delta_imag * (tile_y * BAND_HEIGHT + ty - _origin_y);
+                for (uint32_t tx = 0; tx < TILE_WIDTH; tx++) {
+                    size_t i = size_t(ty) * TILE_WIDTH + tx;
+                    long double dc_real = _offset_real + _delta_real * (key.x * TILE_WIDTH + tx - _origin_x);
+                    tile_smooth[i] = _escape_time(dc_real, dc_imag, tile_iterations[i]);
+                    n_iterations += tile_iterations[i];
+                }
+            }
+            tile_cache->insert(key, tile_iterations, tile_smooth);
+        }
+
+        // Copy the part of the tile inside the view.
+        const int64_t x_offset = key.x * TILE_WIDTH - _origin_x;
+        const uint32_t x_start = uint32_t(std::max<int64_t>(0, x_offset));
+        const uint32_t x_end = uint32_t(std::min<int64_t>(width, x_offset + TILE_WIDTH));
+
+        for (uint32_t y = y_start; y < y_end; y++) {
+            size_t i = size_t(first_row + y - tile_y * BAND_HEIGHT) * TILE_WIDTH + (x_start - x_offset);
+            std::copy_n(tile_iterations + i, x_end - x_start, iterations + size_t(y) * width + x_start);
+            std::copy_n(tile_smooth + i, x_end - x_start, smooth + size_t(y) * width + x_start);
+            for (size_t j = i; j < i + (x_end - x_start); j++)
+                stats.add(tile_iterations[j], tile_smooth[j]);
         }
+        tile_times[key.x - first_column] =
+            std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count();
     }
+    return n_iterations;
 }
 
-void Mandelbrot::_base_algorithm(uint32_t x, uint32_t y) {
-    long double c_real, c_imag, z_real, z_imag, t_real, t_imag;
+uint32_t Mandelbrot::_base_algorithm(uint32_t x, uint32_t y, FrameStats& stats) {
+    long double dc_real, dc_imag;
+
+    if (log_polar) {
+        const long double TWO_PI = 6.28318530717958647692528676655900576839433879875021L;
+        long double angle = TWO_PI * x / width;
+        long double radius = polar_radius * expl(-TWO_PI * (row_offset + y) / width);
+        dc_real = radius * cosl(angle);
+        dc_imag = radius * sinl(angle);
+    }
+    else {
+        dc_imag = _offset_imag + _delta_imag * (row_offset + y);
+        dc_real = _offset_real + _delta_real * x;
+    }
+
+    uint32_t n_iter;
+    float value = _escape_time(dc_real, dc_imag, n_iter);
+    iterations[size_t(y) * width + x] = n_iter;
+    smooth[size_t(y) * width + x] = value;
+    stats.add(n_iter, value);
+    return n_iter;
+}
 
-    uint16_t n_iter = 0;
-    z_real = 0;
-    z_imag = 0;
+float Mandelbrot::_escape_time(long double dc_real, long double dc_imag, uint32_t& n_iter) const {
+    if (_kernel == Kernel::PERTURBATION)
+        return _perturbed_escape_time(double(dc_real), double(dc_imag), n_iter);
+    return _direct_escape_time(_center_real + dc_real, _center_imag + dc_imag, n_iter);
+}
 
-    c_imag = _imag_start + _delta_imag * y;
-    c_real = _real_start + _delta_real * x;
-    c_imag = _imag_start + _delta_imag * y;
-    c_real = _real_start + _delta_real * x;
+float Mandelbrot::_direct_escape_time(long double c_real, long double c_imag, uint32_t& n_iter) const {
+    long double z_real = 0, z_imag = 0, t_real, t_imag;
 
-    while (n_iter < n_iter_max) {
+    n_iter = 0;
+    while (n_iter < _n_iter_max) {
         t_real = z_real * z_real - z_imag * z_imag + c_real;
         t_imag = z_real * z_imag * 2.0 + c_imag;
         z_real = t_real;
         z_imag = t_imag;
         n_iter++;
 
-        if ((z_real * z_real + z_imag * z_imag) >= 128.0)
+        if ((z_real * z_real + z_imag * z_imag) >= BAILOUT)
+            break;
+    }
+
+    return smooth_iteration(n_iter, z_real, z_imag);
+}
+
+float Mandelbrot::_perturbed_escape_time(double dc_real, double dc_imag, uint32_t& n_iter) const {
+    const double* ref_real = _orbit->real.data();
+    const double* ref_imag = _orbit->imag.data();
+    const size_t ref_end = _orbit->real.size() - 1;
+
+    double dz_real = 0, dz_imag = 0, z_real = 0, z_imag = 0;
+    size_t ref = 0;
+
+    n_iter = 0;
+    while (n_iter < _n_iter_max) {
+        // dz' = 2 Z dz + dz^2 + dc
+        double t_real = 2.0 * (ref_real[ref] * dz_real - ref_imag[ref] * dz_imag) + dz_real * dz_real -
+                        dz_imag * dz_imag + dc_real;
+        double t_imag = 2.0 * (ref_real[ref] * dz_imag + ref_imag[ref] * dz_real + dz_real * dz_imag) + dc_imag;
+        dz_real = t_real;
+        dz_imag = t_imag;
+        ref++;
+        n_iter++;
+
+        z_real = ref_real[ref] + dz_real;
+        z_imag = ref_imag[ref] + dz_imag;
+        double abs_squared = z_real * z_real + z_imag * z_imag;
+        if (abs_squared >= BAILOUT)
             break;
+
+        // Rebasing: continue with the full value as delta to Z_0 = 0 when it
+        // is smaller than the delta, or when the reference ends.
+        if (abs_squared < dz_real * dz_real + dz_imag * dz_imag || ref == ref_end) {
+            dz_real = z_real;
+            dz_imag = z_imag;
+            ref = 0;
+        }
     }
 
-    iterations[y * width + x] = n_iter;
-    real_parts[y * width + x] = z_real;
-    imag_parts[y * width + x] = z_imag;
+    return smooth_iteration(n_iter, z_real, z_imag);
+}
+
+float Mandelbrot::smooth_iteration(uint32_t n_iter, long double z_real, long double z_imag) {
+    const long double Q1_LOG_2 = 1.44269504088896340735992468100189213742664595415299L;
+    const long double LOG_LOG_BAILOUT = logl(logl(BAILOUT));
+
+    long double abs_squared = z_real * z_real + z_imag * z_imag;
+    if (abs_squared < BAILOUT)
+        return INTERIOR;
+
+    return n_iter + (LOG_LOG_BAILOUT - logl(logl(sqrtl(abs_squared)))) * Q1_LOG_2;
+}
+
+uint32_t Mandelbrot::choose_iterations(uint32_t max_iterations, uint32_t min_iterations) {
+    Trace::Span span("Choose iterations", "frame");
+    Mandelbrot probe(std::max(1U, width / PROBE_SCALE), std::max(1U, frame_height / PROBE_SCALE), _pool);
+    probe.center_point = center_point;
+    probe.magnification = magnification;
+    probe.kernel = kernel;
+    probe.log_polar = log_polar;
+    probe.polar_radius = polar_radius;
+
+    probe.n_iter_max = std::min(std::max(minimum_iterations(magnification), min_iterations), max_iterations);
+    while (probe.n_iter_max < max_iterations) {
+        probe.has_changed = true;
+        probe.update();
+
+        const FrameStats& stats = probe.frame_stats();
+        uint64_t upper_half = 0;
+        for (uint32_t i = 0; i < FrameStats::HISTOGRAM_BINS; i++)
+            if (uint64_t(i) << stats.bin_shift >= probe.n_iter_max / 2)
+                upper_half += stats.histogram[i];
+
+        // Pixels at the limit which a higher one could still let escape.
+        uint64_t undecided = 0;
+        for (uint32_t y = 0; y < probe.height; y++) {
+            const long double c_imag = probe._center_imag + probe._offset_imag + probe._delta_imag * y;
+            for (uint32_t x = 0; x < probe.width; x++) {
+                const long double c_real = probe._center_real + probe._offset_real + probe._delta_real * x;
+                undecided += probe.smooth[size_t(y) * probe.width + x] == INTERIOR &&
+                             (log_polar || !inside_main_bulbs(c_real, c_imag));
+            }
+        }
+
+        // Raise while escapes are still slow, or none happen yet.
+        const uint64_t significant = stats.pixels / 1000;
+        const bool slow = upper_half > significant || upper_half * 100 > stats.escaped || stats.escaped == 0;
+        if (undecided <= significant || !slow)
+            break;
+        probe.n_iter_max = uint32_t(std::min<uint64_t>(uint64_t(probe.n_iter_max) * 2, max_iterations));
+    }
+    return probe.n_iter_max;
+}
+
+void Mandelbrot::reserve_precision(long double magnification) {
+    const mp_bitcnt_t precision = precision_bits(magnification, width);
+    if (center_point.real.get_prec() < precision) {
+        center_point.real.set_prec(precision);
+        center_point.imag.set_prec(precision);
+    }
+}
+
+uint32_t Mandelbrot::minimum_iterations(long double magnification) {
+    const double octaves = std::max(0.0, std::log2(double(magnification)));
+    uint32_t n_iter = 64;
+    while (n_iter < 64 + 32 * octaves)
+        n_iter *= 2;
+    return n_iter;
+}
+
+Mandelbrot::Kernel Mandelbrot::parse_kernel(const std::string& name) {
+    if (name == "direct")
+        return Kernel::DIRECT;
+    if (name == "perturbation")
+        return Kernel::PERTURBATION;
+    throw std::invalid_argument("Unknown kernel: " + name);
 }
 
 void Mandelbrot::change_region(const int increment) {
@@ -80,7 +470,66 @@ void Mandelbrot::change_region(const int increment) {
 
     region_index = ((region_index + increment) % num_regions + num_regions) % num_regions;
 
-    center_point.real = PRESETS[region_index][0];
-    center_point.imag = PRESETS[region_index][1];
+    center_point.real = parse_coordinate(PRESETS[region_index][0]);
+    center_point.imag = parse_coordinate(PRESETS[region_index][1]);
     magnification = 1.0L;
 }
+
+void Mandelbrot::move(long double real, long double imag) {
+    reserve_precision(magnification);
+    center_point.real += double(real / magnification);
+    center_point.imag += double(imag / magnification);
+}
+
+mp_bitcnt_t Mandelbrot::precision_bits(long double magnification, uint32_t width) {
+    // Pixels need to be distinguishable with some bits to spare.
+    long double bits = std::max(0.0L, log2l(magnification * width)) + 64;
+    return mp_bitcnt_t(ceill(bits / 64) * 64);
+}
+
+Complex& Complex::operator=(const Complex& other) {
+    real.set_prec(other.real.get_prec());
+    imag.set_prec(other.imag.get_prec());
+    real = other.real;
+    imag = other.imag;
+    return *this;
+}
+
+mpf_class parse_coordinate(const std::string& text) {
+    // About 3.32 bits per decimal digit plus some spare, at least long double.
+    mp_bitcnt_t precision = std::max<mp_bitcnt_t>(64, text.size() * 10 / 3 + 32);
+    mpf_class value(0, precision);
+    // GMP does not accept an explicit plus sign.
+    const bool plus = !text.empty() && text[0] == '+';
+    if (value.set_str(plus ? text.substr(1) : text, 10) != 0)
+        throw std::invalid_argument("Invalid coordinate: " + text);
+    return value;
+}
+
+std::string format_coordinate(const mpf_class& value, int digits) {
+    mp_exp_t exponent;
+    std::string mantissa = value.get_str(exponent, 10, digits);
+    bool negative = !mantissa.empty() && mantissa[0] == '-';
+    if (negative)
+        mantissa.erase(0, 1);
+    if (mantissa.empty())
+        return "+0.0";
+
+    // Plain decimal notation: 0.000ddd for small values, d.ddd otherwise.
+    std::string text;
+    if (exponent <= 0)
+        text = "0." + std::string(-exponent, '0') + mantissa;
+    else if (size_t(exponent) >= mantissa.size())
+        text = mantissa + std::string(exponent - mantissa.size(), '0') + ".0";
+    else
+        text = mantissa.substr(0, exponent) + "." + mantissa.substr(exponent);
+
+    return (negative ? "-" : "+") + text;
+}
+
+long double to_long_double(const mpf_class& value) {
+    // Two doubles cover the 64 bit mantissa of long double.
+    double high = value.get_d();
+    mpf_class rest(value - high, value.get_prec());
+    return (long double)high + rest.get_d();
+}
@@ -0,0 +1,27 @@
+#include "options.hpp"
+
+Options::Options(int argc, char* argv[]) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+
+        if (arg.rfind("--", 0) != 0) {
+            positional.push_back(arg);
+            continue;
+        }
+
+        size_t split = arg.find('=');
+        if (split == std::string::npos)
+            _values[arg.substr(2)] = "";
+        else
+            _values[arg.substr(2, split - 2)] = arg.substr(split + 1);
+    }
+}
+
+bool Options::has(const std::string& name) const {
+    return _values.count(name) > 0;
+}
+
+std::string Options::get(const std::string& name, const std::string& fallback) const {
+    auto it = _values.find(name);
+    return it == _values.end() ? fallback : it->second;
+}
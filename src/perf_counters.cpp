@@ -0,0 +1,74 @@
+#include "perf_counters.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+void PerfCounters::_open(Counter counter, uint32_t type, uint64_t config) {
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.inherit = _target == Target::PROCESS;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    int fd = int(syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC));
+    // The process counters already reported what is missing.
+    if (fd < 0 && _target == Target::PROCESS)
+        std::cerr << "[INFO] Performance counter " << name(counter) << " not available: " << std::strerror(errno)
+                  << std::endl;
+    _fds[size_t(counter)] = fd;
+}
+
+PerfCounters::PerfCounters(uint64_t raw_event, Target target) : _target(target) {
+    _fds.fill(-1);
+    _open(Counter::CYCLES, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+    _open(Counter::INSTRUCTIONS, PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+    _open(Counter::CACHE_MISSES, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+    _open(Counter::BRANCH_MISSES, PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+    if (raw_event != 0)
+        _open(Counter::RAW, PERF_TYPE_RAW, raw_event);
+}
+
+PerfCounters::~PerfCounters() {
+    for (int fd : _fds)
+        if (fd >= 0)
+            ::close(fd);
+}
+
+bool PerfCounters::available(Counter counter) const {
+    return _fds[size_t(counter)] >= 0;
+}
+
+PerfCounters::Values PerfCounters::read() const {
+    Values values = {};
+    for (size_t i = 0; i < N_COUNTERS; i++) {
+        uint64_t data[3]; // value, time enabled, time running
+        if (_fds[i] < 0 || ::read(_fds[i], data, sizeof(data)) != sizeof(data))
+            continue;
+        values[i] = data[2] > 0 && data[2] < data[1] ? uint64_t(double(data[0]) * data[1] / data[2]) : data[0];
+    }
+    return values;
+}
+
+const char* PerfCounters::name(Counter counter) {
+    switch (counter) {
+    case Counter::CYCLES:
+        return "cycles";
+    case Counter::INSTRUCTIONS:
+        return "instructions";
+    case Counter::CACHE_MISSES:
+        return "cache-misses";
+    case Counter::BRANCH_MISSES:
+        return "branch-misses";
+    case Counter::RAW:
+        return "raw";
+    }
+    return "";
+}
@@ -0,0 +1,186 @@
+#include "png_encoder.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <future>
+#include <stdexcept>
+#include <zlib.h>
+
+namespace {
+
+constexpr size_t BYTES_PER_PIXEL = 3;
+constexpr size_t WINDOW_SIZE = 32U << 10;
+constexpr size_t IDAT_SIZE = 1U << 20;
+
+void put_u32(std::vector<uint8_t>& out, uint32_t value) {
+    out.push_back(value >> 24);
+    out.push_back(value >> 16);
+    out.push_back(value >> 8);
+    out.push_back(value);
+}
+
+void put_chunk(std::vector<uint8_t>& out, const char* type, const uint8_t* data, size_t size) {
+    put_u32(out, size);
+    size_t start = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data, data + size);
+    put_u32(out, crc32(0, out.data() + start, size + 4));
+}
+
+uint8_t paeth(int a, int b, int c) {
+    int p = a + b - c;
+    int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+    if (pa <= pb && pa <= pc)
+        return a;
+    return pb <= pc ? b : c;
+}
+
+// Converts row `y` to RGB and applies the filter with the smallest sum of
+// absolute (signed) residuals, the usual libpng heuristic.
+void filter_row(const uint8_t* rgba, uint32_t width, uint32_t y, bool adaptive, uint8_t* out) {
+    const size_t stride = size_t(width) * BYTES_PER_PIXEL;
+    std::vector<uint8_t> row(stride), prev(stride, 0);
+
+    for (size_t x = 0; x < width; x++) {
+        const uint8_t* pixel = rgba + (size_t(y) * width + x) * 4;
+        std::copy(pixel, pixel + 3, row.data() + x * 3);
+        if (y > 0) {
+            const uint8_t* above = pixel - size_t(width) * 4;
+            std::copy(above, above + 3, prev.data() + x * 3);
+        }
+    }
+
+    out[0] = 0;
+    std::copy(row.begin(), row.end(), out + 1);
+    if (!adaptive)
+        return;
+
+    std::vector<uint8_t> candidate(stride);
+    uint64_t best_cost = UINT64_MAX;
+
+    for (uint8_t filter = 0; filter < 5; filter++) {
+        uint64_t cost = 0;
+        for (size_t i = 0; i < stride; i++) {
+            int a = i >= BYTES_PER_PIXEL ? row[i - BYTES_PER_PIXEL] : 0;
+            int b = prev[i];
+            int c = i >= BYTES_PER_PIXEL ? prev[i - BYTES_PER_PIXEL] : 0;
+            uint8_t predicted = 0;
+            switch (filter) {
+            case 1: predicted = a; break;
+            case 2: predicted = b; break;
+            case 3: predicted = (a + b) / 2; break;
+            case 4: predicted = paeth(a, b, c); break;
+            }
+            candidate[i] = row[i] - predicted;
+            cost += std::abs(int8_t(candidate[i]));
+        }
+        if (cost < best_cost) {
+            best_cost = cost;
+            out[0] = filter;
+            std::copy(candidate.begin(), candidate.end(), out + 1);
+        }
+    }
+}
+
+// Raw deflate of `data[start, end)`. All but the last chunk end with a sync
+// flush, so the outputs are byte aligned and can simply be concatenated.
+std::vector<uint8_t> deflate_chunk(const std::vector<uint8_t>& data, size_t start, size_t end, int level) {
+    z_stream stream = {};
+    if (deflateInit2(&stream, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        throw std::runtime_error("deflateInit2 failed");
+
+    if (start > 0) {
+        size_t dict_start = start > WINDOW_SIZE ? start - WINDOW_SIZE : 0;
+        deflateSetDictionary(&stream, data.data() + dict_start, start - dict_start);
+    }
+
+    const bool last = end == data.size();
+    std::vector<uint8_t> out(deflateBound(&stream, end - start) + 16);
+    stream.next_in = const_cast<Bytef*>(data.data() + start);
+    stream.avail_in = end - start;
+
+    // The bound normally suffices for one call. A flush is only complete once
+    // it leaves room in the output, otherwise it continues in a larger buffer.
+    int status;
+    do {
+        if (stream.total_out == out.size())
+            out.resize(out.size() * 2);
+        stream.next_out = out.data() + stream.total_out;
+        stream.avail_out = out.size() - stream.total_out;
+        status = deflate(&stream, last ? Z_FINISH : Z_SYNC_FLUSH);
+    } while ((status == Z_OK || status == Z_BUF_ERROR) && stream.avail_out == 0);
+
+    deflateEnd(&stream);
+    if (status != (last ? Z_STREAM_END : Z_OK) || stream.avail_in != 0)
+        throw std::runtime_error("deflate failed");
+
+    out.resize(stream.total_out);
+    return out;
+}
+
+} // namespace
+
+std::vector<uint8_t> PngEncoder::encode(const uint8_t* rgba, uint32_t width, uint32_t height, int level,
+                                        ThreadPool& pool) {
+    level = std::clamp(level, 0, 9);
+
+    const size_t row_size = size_t(width) * BYTES_PER_PIXEL + 1;
+    const size_t rows_per_chunk = std::max<size_t>(1, CHUNK_SIZE / row_size);
+    const size_t n_chunks = (height + rows_per_chunk - 1) / rows_per_chunk;
+
+    // Filtering first, every chunk needs the raw tail of its predecessor as
+    // dictionary before it can be deflated.
+    std::vector<uint8_t> filtered(row_size * height);
+    std::vector<std::future<void>> futures;
+
+    for (size_t chunk = 0; chunk < n_chunks; chunk++) {
+        futures.push_back(pool.submit([&, chunk]() {
+            size_t y_end = std::min<size_t>((chunk + 1) * rows_per_chunk, height);
+            for (size_t y = chunk * rows_per_chunk; y < y_end; y++)
+                filter_row(rgba, width, y, level > 0, filtered.data() + y * row_size);
+        }));
+    }
+    for (auto& future : futures)
+        future.get();
+    futures.clear();
+
+    std::vector<std::vector<uint8_t>> compressed(n_chunks);
+    std::vector<uLong> checksums(n_chunks);
+
+    for (size_t chunk = 0; chunk < n_chunks; chunk++) {
+        futures.push_back(pool.submit([&, chunk]() {
+            size_t start = chunk * rows_per_chunk * row_size;
+            size_t end = std::min(filtered.size(), start + rows_per_chunk * row_size);
+            compressed[chunk] = deflate_chunk(filtered, start, end, level);
+            checksums[chunk] = adler32(adler32(0, nullptr, 0), filtered.data() + start, end - start);
+        }));
+    }
+    for (auto& future : futures)
+        future.get();
+
+    // zlib stream: header, concatenated deflate chunks, combined adler32.
+    std::vector<uint8_t> zdata = {0x78, uint8_t(level < 2 ? 0x01 : level < 6 ? 0x5E : level == 6 ? 0x9C : 0xDA)};
+    uLong checksum = adler32(0, nullptr, 0);
+
+    for (size_t chunk = 0; chunk < n_chunks; chunk++) {
+        size_t start = chunk * rows_per_chunk * row_size;
+        size_t length = std::min(filtered.size(), start + rows_per_chunk * row_size) - start;
+        zdata.insert(zdata.end(), compressed[chunk].begin(), compressed[chunk].end());
+        checksum = adler32_combine(checksum, checksums[chunk], length);
+    }
+    put_u32(zdata, checksum);
+
+    std::vector<uint8_t> png = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+
+    std::vector<uint8_t> header;
+    put_u32(header, width);
+    put_u32(header, height);
+    header.insert(header.end(), {8, 2, 0, 0, 0}); // 8 bit, truecolor, deflate, adaptive filter, no interlace
+    put_chunk(png, "IHDR", header.data(), header.size());
+
+    for (size_t offset = 0; offset < zdata.size(); offset += IDAT_SIZE)
+        put_chunk(png, "IDAT", zdata.data() + offset, std::min(IDAT_SIZE, zdata.size() - offset));
+    put_chunk(png, "IEND", nullptr, 0);
+
+    return png;
+}
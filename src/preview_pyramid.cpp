@@ -0,0 +1,70 @@
+#include "preview_pyramid.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+void PreviewPyramid::store(const float* smooth, uint32_t width, uint32_t height,
+                           const Complex& center, long double magnification) {
+    _center = center;
+    _pixel_size = 4.0L / magnification / width;
+
+    _levels.resize(1);
+    _levels[0] = {width, height, std::vector<float>(smooth, smooth + size_t(width) * height)};
+
+    // Each level averages 2x2 pixels of the previous one. Interior points have
+    // no meaningful value, a pixel is interior if most of its sources are.
+    while (_levels.size() < MAX_LEVELS && _levels.back().width > 1 && _levels.back().height > 1) {
+        const Level& fine = _levels.back();
+        Level coarse = {(fine.width + 1) / 2, (fine.height + 1) / 2, {}};
+        coarse.smooth.resize(size_t(coarse.width) * coarse.height);
+
+        for (uint32_t y = 0; y < coarse.height; y++) {
+            for (uint32_t x = 0; x < coarse.width; x++) {
+                float sum = 0.0f;
+                int n = 0;
+                for (uint32_t sy = 2 * y; sy < std::min(2 * y + 2, fine.height); sy++) {
+                    for (uint32_t sx = 2 * x; sx < std::min(2 * x + 2, fine.width); sx++) {
+                        float value = fine.smooth[size_t(sy) * fine.width + sx];
+                        if (value != Mandelbrot::INTERIOR) {
+                            sum += value;
+                            n++;
+                        }
+                    }
+                }
+                coarse.smooth[size_t(y) * coarse.width + x] = n >= 2 ? sum / n : Mandelbrot::INTERIOR;
+            }
+        }
+        _levels.push_back(std::move(coarse));
+    }
+}
+
+bool PreviewPyramid::resample(const Complex& center, long double magnification, uint32_t width, uint32_t height,
+                              float* out) const {
+    if (_levels.empty())
+        return false;
+
+    // Position of the new view in pixels of the stored frame, see
+    // `Mandelbrot::update` for the mapping of pixels to the plane.
+    const long double scale = 4.0L / magnification / width / _pixel_size;
+    const long double shift_x = to_long_double(center.real - _center.real) / _pixel_size;
+    const long double shift_y = to_long_double(center.imag - _center.imag) / _pixel_size;
+    const double u_start = double(shift_x + _levels[0].width / 2.0L - width / 2.0L * scale);
+    const double v_start = double(_levels[0].height / 2.0L - shift_y - height / 2.0L * scale);
+
+    const int level_index = std::clamp(int(std::floor(std::log2(double(scale)))), 0, int(_levels.size()) - 1);
+    const Level& level = _levels[level_index];
+    const double level_scale = std::ldexp(1.0, -level_index);
+
+    for (uint32_t y = 0; y < height; y++) {
+        const double v = (v_start + (y + 0.5) * double(scale)) * level_scale;
+        for (uint32_t x = 0; x < width; x++) {
+            const double u = (u_start + (x + 0.5) * double(scale)) * level_scale;
+
+            float value = Mandelbrot::INTERIOR;
+            if (u >= 0 && v >= 0 && u < level.width && v < level.height)
+                value = level.smooth[size_t(v) * level.width + size_t(u)];
+            out[size_t(y) * width + x] = value;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,179 @@
+#include "reference_orbit.hpp"
+#include "image_writer.hpp"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <unistd.h>
+
+namespace {
+
+constexpr char MAGIC[8] = {'M', 'B', 'O', 'R', 'B', 'I', 'T', '2'};
+
+// Followed by the key, which makes a hash collision of file names harmless,
+// and the orbit.
+struct OrbitFileHeader {
+    char magic[8]; // "MBORBIT2"
+    uint64_t key_length;
+    uint64_t precision;
+    uint64_t length;
+};
+
+// Exact hexadecimal representation of the center, the same for every
+// precision it is stored with.
+std::string orbit_key(const Complex& center, uint32_t n_iter_max) {
+    std::string key;
+    for (const mpf_class* value : {&center.real, &center.imag}) {
+        mp_exp_t exponent;
+        const std::string digits = value->get_str(exponent, 16, 0);
+        key += digits + "@" + std::to_string(exponent) + " ";
+    }
+    return key + std::to_string(n_iter_max);
+}
+
+bool read_all(int fd, void* data, size_t size) {
+    uint8_t* bytes = static_cast<uint8_t*>(data);
+    while (size > 0) {
+        ssize_t n = ::read(fd, bytes, size);
+        if (n <= 0)
+            return false;
+        bytes += n;
+        size -= n;
+    }
+    return true;
+}
+
+} // namespace
+
+ReferenceOrbit ReferenceOrbit::compute(const Complex& center, uint32_t n_iter_max, mp_bitcnt_t precision) {
+    ReferenceOrbit orbit;
+    orbit.precision = precision;
+    orbit.real.reserve(n_iter_max + 1);
+    orbit.imag.reserve(n_iter_max + 1);
+
+    const mpf_class c_real(center.real, precision), c_imag(center.imag, precision);
+    mpf_class z_real(0, precision), z_imag(0, precision), real_squared(0, precision), imag_squared(0, precision);
+    orbit.real.push_back(0);
+    orbit.imag.push_back(0);
+
+    // Escape is checked on the rounded values, the orbit only has to be exact
+    // while it is small.
+    double abs_squared = 0;
+    for (uint32_t n = 0; n < n_iter_max && abs_squared < Mandelbrot::BAILOUT; n++) {
+        real_squared = z_real * z_real;
+        imag_squared = z_imag * z_imag;
+        z_imag = 2 * z_real * z_imag + c_imag;
+        z_real = real_squared - imag_squared + c_real;
+
+        double real = z_real.get_d(), imag = z_imag.get_d();
+        orbit.real.push_back(real);
+        orbit.imag.push_back(imag);
+        abs_squared = real * real + imag * imag;
+    }
+    return orbit;
+}
+
+void OrbitCache::set_directory(const std::string& directory) {
+    std::filesystem::create_directories(directory);
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _directory = directory;
+}
+
+std::shared_ptr<const ReferenceOrbit> OrbitCache::get(const Complex& center, uint32_t n_iter_max,
+                                                      mp_bitcnt_t precision) {
+    const std::string key = orbit_key(center, n_iter_max);
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    auto found = _orbits.find(key);
+    if (found != _orbits.end() && found->second->precision >= precision)
+        return found->second;
+
+    std::string path;
+    std::shared_ptr<const ReferenceOrbit> orbit;
+    if (!_directory.empty()) {
+        char name[32];
+        std::snprintf(name, sizeof(name), "%016zx.orbit", std::hash<std::string>()(key));
+        path = (std::filesystem::path(_directory) / name).string();
+        orbit = _load(path, key, precision);
+    }
+
+    if (!orbit) {
+        orbit = std::make_shared<const ReferenceOrbit>(ReferenceOrbit::compute(center, n_iter_max, precision));
+        if (!path.empty())
+            _save(path, key, *orbit);
+    }
+
+    // A more precise orbit replaces the one in place.
+    if (found != _orbits.end()) {
+        found->second = orbit;
+        return orbit;
+    }
+
+    if (_order.size() == MAX_ORBITS) {
+        _orbits.erase(_order.front());
+        _order.pop_front();
+    }
+    _orbits[key] = orbit;
+    _order.push_back(key);
+    return orbit;
+}
+
+std::shared_ptr<const ReferenceOrbit> OrbitCache::_load(const std::string& path, const std::string& key,
+                                                        mp_bitcnt_t precision) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return nullptr;
+
+    OrbitFileHeader header;
+    std::string stored_key;
+    auto orbit = std::make_shared<ReferenceOrbit>();
+    bool valid = read_all(fd, &header, sizeof(header)) && std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) == 0 &&
+                 header.key_length == key.size() && header.precision >= precision;
+    if (valid) {
+        stored_key.resize(header.key_length);
+        valid = read_all(fd, stored_key.data(), stored_key.size()) && stored_key == key;
+    }
+    if (valid) {
+        orbit->precision = header.precision;
+        orbit->real.resize(header.length);
+        orbit->imag.resize(header.length);
+        valid = read_all(fd, orbit->real.data(), header.length * sizeof(double)) &&
+                read_all(fd, orbit->imag.data(), header.length * sizeof(double));
+    }
+    ::close(fd);
+
+    return valid ? orbit : nullptr;
+}
+
+void OrbitCache::_save(const std::string& path, const std::string& key, const ReferenceOrbit& orbit) {
+    OrbitFileHeader header = {};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.key_length = key.size();
+    header.precision = orbit.precision;
+    header.length = orbit.real.size();
+
+    // Written under a temporary name, so readers never see a partial file.
+    const std::string temporary = path + ".tmp" + std::to_string(::getpid());
+    int fd = open_output_file(temporary);
+    try {
+        write_all(fd, reinterpret_cast<const uint8_t*>(&header), sizeof(header));
+        write_all(fd, reinterpret_cast<const uint8_t*>(key.data()), key.size());
+        write_all(fd, reinterpret_cast<const uint8_t*>(orbit.real.data()), orbit.real.size() * sizeof(double));
+        write_all(fd, reinterpret_cast<const uint8_t*>(orbit.imag.data()), orbit.imag.size() * sizeof(double));
+    }
+    catch (...) {
+        ::close(fd);
+        std::filesystem::remove(temporary);
+        throw;
+    }
+    ::close(fd);
+    std::filesystem::rename(temporary, path);
+}
+
+OrbitCache& OrbitCache::shared() {
+    static OrbitCache cache;
+    return cache;
+}
@@ -1,8 +1,9 @@
 #include "renderer.hpp"
-#include "colors.h"
+#include "colorizer.hpp"
 #include "font_data.h"
 #include "mandelbrot.hpp"
 
+#include <algorithm>
 #include <cmath>
 #include <iomanip>
 #include <iostream>
@@ -10,7 +11,6 @@
 #include <string>
 
 std::string WINDOW_NAME = "Mandelbrot-Set Visualizer";
-const uint8_t RGBA_SIZE = 4; // RGA Alpha color codes have four values
 
 std::string toScientificString(double value, int precision) {
     std::ostringstream out;
@@ -24,10 +24,10 @@ std::string toStringWithPrecision(double value, int precision) {
     return out.str();
 }
 
-std::string longDoubleToString(long double value) {
-    std::ostringstream out;
-    out << std::setprecision(std::numeric_limits<long double>::digits10) << value;
-    return out.str();
+// Enough digits to tell pixels of the current view apart.
+std::string coordinateToString(const mpf_class& value, long double magnification, uint32_t width) {
+    const int digits = int(log10l(magnification * width)) + 3;
+    return format_coordinate(value, std::max(int(std::numeric_limits<long double>::digits10), digits));
 }
 
 Renderer::Renderer(const uint32_t screen_width, const uint32_t screen_height)
@@ -41,7 +41,8 @@ Renderer::Renderer(const uint32_t screen_width, const uint32_t screen_height)
     // Kind of the pixel canvas
     screen_texture.create(screen_width, screen_height);
     screen_sprite.setTexture(screen_texture);
-    pixels = new sf::Uint8[screen_width * screen_height * RGBA_SIZE];
+    pixels = new sf::Uint8[screen_width * screen_height * Colorizer::RGBA_SIZE];
+    heat.resize(size_t(screen_width) * screen_height);
 
     // Info text
     // NOTE: `xxd -i font.ttf > font_data.h`
@@ -59,55 +60,121 @@ Renderer::Renderer(const uint32_t screen_width, const uint32_t screen_height)
 }
 
 void Renderer::update(Mandelbrot* mandelbrot) {
-    // Source: https://github.com/josch/mandelbrot (Wikipedia animation)
-    const long double Q1_LOG_2 = 1.44269504088896340735992468100189213742664595415299L;
-    const long double LOG_2 = 0.69314718055994530941723212145817656807550013436026L;
-    const long double BAILOUT = 128.0L;
-    const long double LOG_LOG_BAILOUT = log(log(BAILOUT));
-
-    uint32_t n_pixel = 0;
-
-    for (uint32_t i = 0; i < screen_width * screen_height; i++) {
-        long double real_squared = mandelbrot->real_parts[i] * mandelbrot->real_parts[i] +
-                                   mandelbrot->imag_parts[i] * mandelbrot->imag_parts[i];
-
-        if (real_squared < BAILOUT) {
-            pixels[n_pixel++] = 0;
-            pixels[n_pixel++] = 0;
-            pixels[n_pixel++] = 0;
-            pixels[n_pixel++] = 255;
-            continue;
-        };
-
-        long double r = sqrtl(real_squared);
-        long double c = mandelbrot->iterations[i] - 1.28 + (LOG_LOG_BAILOUT - logl(logl(r))) * Q1_LOG_2;
-        size_t idx = fmodl((logl(c / 64 + 1) / LOG_2 + 0.45), 1) * GRADIENT_LENGTH + 0.5;
-
-        pixels[n_pixel++] = COLOR_TABLE[idx][0];
-        pixels[n_pixel++] = COLOR_TABLE[idx][1];
-        pixels[n_pixel++] = COLOR_TABLE[idx][2];
-        pixels[n_pixel++] = 255;
-
-        // KILL ME: Less computational color scheme
-        // pixels[n_pixel++] = mandelbrot->iterations[i] % 256;
-        // pixels[n_pixel++] = 1 / 255 * mandelbrot->iterations[i] % 256;
-        // pixels[n_pixel++] = mandelbrot->iterations[i] * mandelbrot->iterations[i] % 256;
-        // pixels[n_pixel++] = 255;
+    {
+        FrameTimer::Scope scope(timing, FrameTimer::Stage::COLOR);
+        _colorize_rows(*mandelbrot, 0, screen_height);
+    }
+    {
+        FrameTimer::Scope scope(timing, FrameTimer::Stage::UPLOAD);
+        screen_texture.update(pixels);
+        screen_sprite.setTexture(screen_texture);
     }
 
-    screen_texture.update(pixels);
-    screen_sprite.setTexture(screen_texture);
+    // Update info text, the time of the stages in the last frame they ran, or
+    // the workers or escape statistics of the last computation
+    if (info_mode == InfoMode::TIMING) {
+        std::string text;
+        for (size_t i = 0; i < FrameTimer::N_STAGES; i++) {
+            const FrameTimer::Stage stage = FrameTimer::Stage(i);
+            text += std::string("   ") + FrameTimer::stage_name(stage) + ": " +
+                    toStringWithPrecision(timing.last(stage) * 1e3, 2) + " ms";
+        }
+        info_text.setString(text + "   Compute p95: " +
+                            toStringWithPrecision(timing.percentile(FrameTimer::Stage::COMPUTE, 0.95) * 1e3, 2) +
+                            " ms");
+        return;
+    }
+    if (info_mode == InfoMode::WORKERS) {
+        const std::vector<Mandelbrot::WorkerStats>& workers = mandelbrot->worker_stats();
+        double busy_time = 0.0, min_rate = workers.empty() ? 0.0 : 1e300, max_rate = 0.0;
+        uint64_t n_iterations = 0;
+        for (const Mandelbrot::WorkerStats& stats : workers) {
+            busy_time += stats.busy_time;
+            n_iterations += stats.iterations;
+            min_rate = std::min(min_rate, stats.iteration_rate());
+            max_rate = std::max(max_rate, stats.iteration_rate());
+        }
+        const double busy = workers.empty() ? 0.0 : busy_time / (workers.size() * mandelbrot->frame_time);
+        info_text.setString("   Workers: " + std::to_string(workers.size()) +
+                            "   Imbalance: " + toStringWithPrecision(mandelbrot->imbalance(), 2) +
+                            "   Busy: " + toStringWithPrecision(busy * 100.0, 1) + " %" +
+                            "   Iterations: " + toScientificString(n_iterations, 2) +
+                            "   Per worker: " + toScientificString(min_rate, 2) + " - " +
+                            toScientificString(max_rate, 2) + " /s");
+        return;
+    }
+    if (info_mode == InfoMode::STATISTICS) {
+        const Mandelbrot::FrameStats& stats = mandelbrot->frame_stats();
+        info_text.setString("   Escaped: " + toStringWithPrecision(stats.escape_ratio() * 100.0, 1) + " %" +
+                            "   At MaxIter: " + std::to_string(stats.interior()) +
+                            "   Iterations of escaped min/mean/max: " +
+                            std::to_string(stats.escaped > 0 ? stats.min_iterations : 0) + " / " +
+                            toStringWithPrecision(stats.mean_iterations(), 1) + " / " +
+                            std::to_string(stats.max_iterations));
+        return;
+    }
+
+    const long double magnification = mandelbrot->magnification;
+    const Complex& center = mandelbrot->center_point;
+    std::string text = "   [" + std::to_string(mandelbrot->region_index + 1) +
+                       "/22]   Real:" + coordinateToString(center.real, magnification, screen_width) +
+                       "   Imag: " + coordinateToString(center.imag, magnification, screen_width) +
+                       "   Magnif.: " + toScientificString(magnification, 2) +
+                       "   MaxIter: " + toStringWithPrecision(mandelbrot->n_iter_max, 0) +
+                       (mandelbrot->auto_iterations > 0 ? " (auto)" : "") + "   Zoom-F.: x" +
+                       toStringWithPrecision(zoom_factor, 2);
+    if (heat_mode == HeatMode::ITERATIONS)
+        text += "   Heat: iterations (log)";
+    else if (heat_mode == HeatMode::TILE_TIME)
+        text += "   Heat: tile time, max " + toStringWithPrecision(max_tile_time * 1e3, 3) + " ms";
+    info_text.setString(text);
+}
+
+void Renderer::update_rows(const Mandelbrot& mandelbrot, uint32_t y_start, uint32_t y_end) {
+    const size_t first = size_t(y_start) * screen_width;
+    {
+        FrameTimer::Scope scope(timing, FrameTimer::Stage::COLOR);
+        _colorize_rows(mandelbrot, y_start, y_end);
+    }
 
-    // Update info text
-    info_text.setString("   [" + std::to_string(mandelbrot->region_index + 1) +
-                        "/22]   Real:" + longDoubleToString(mandelbrot->center_point.real) +
-                        "   Imag: " + longDoubleToString(mandelbrot->center_point.imag) +
-                        "   Magnif.: " + toScientificString(mandelbrot->magnification, 2) +
-                        "   MaxIter: " + toStringWithPrecision(mandelbrot->n_iter_max, 0) + "   Zoom-F.: x" +
-                        toStringWithPrecision(zoom_factor, 2));
+    FrameTimer::Scope scope(timing, FrameTimer::Stage::UPLOAD);
+    screen_texture.update(pixels + first * Colorizer::RGBA_SIZE, screen_width, y_end - y_start, 0, y_start);
+}
+
+void Renderer::_colorize_rows(const Mandelbrot& mandelbrot, uint32_t y_start, uint32_t y_end) {
+    const size_t first = size_t(y_start) * screen_width;
+    const size_t count = size_t(y_end - y_start) * screen_width;
+    if (heat_mode == HeatMode::OFF) {
+        Colorizer::colorize(mandelbrot.smooth + first, pixels + first * Colorizer::RGBA_SIZE, count);
+        return;
+    }
+
+    // Iterations on a log scale up to the maximum, tile times relative to the
+    // slowest tile so far. Rows come in order, so the scale only grows.
+    if (heat_mode == HeatMode::ITERATIONS) {
+        const float scale = 1.0f / std::log1p(float(mandelbrot.n_iter_max));
+        for (size_t i = first; i < first + count; i++)
+            heat[i] = std::log1p(float(mandelbrot.iterations[i])) * scale;
+    }
+    else {
+        if (y_start == 0)
+            max_tile_time = 0.0;
+        for (uint32_t y = y_start; y < y_end; y++) {
+            for (uint32_t x = 0; x < screen_width; x++) {
+                heat[size_t(y) * screen_width + x] = float(mandelbrot.tile_time(x, y));
+                max_tile_time = std::max(max_tile_time, mandelbrot.tile_time(x, y));
+            }
+        }
+        const float scale = max_tile_time > 0.0 ? float(1.0 / max_tile_time) : 0.0f;
+        for (size_t i = first; i < first + count; i++)
+            heat[i] *= scale;
+    }
+    Colorizer::heatmap(heat.data() + first, pixels + first * Colorizer::RGBA_SIZE, count);
 }
 
 void Renderer::show() {
+    // Includes waiting for the frame rate limit.
+    FrameTimer::Scope scope(timing, FrameTimer::Stage::PRESENT);
     window.clear();
 
     window.draw(screen_sprite);
@@ -118,6 +185,7 @@ void Renderer::show() {
 }
 
 void Renderer::check_events(sf::RenderWindow& window, Mandelbrot& mandelbrot) {
+    FrameTimer::Scope scope(timing, FrameTimer::Stage::EVENTS);
     while (window.pollEvent(event)) {
         switch (event.type) {
 
@@ -161,6 +229,14 @@ void Renderer::_key_press_mappings(sf::Event& event, sf::RenderWindow& window, M
             zoom_factor += 0.25;
         return;
 
+    case sf::Keyboard::T:
+        info_mode = InfoMode((int(info_mode) + 1) % 4);
+        return;
+
+    case sf::Keyboard::C:
+        heat_mode = HeatMode((int(heat_mode) + 1) % 3);
+        return;
+
     case sf::Keyboard::R:
         mandelbrot.magnification = 1.0L;
         mandelbrot.n_iter_max = 16U;
@@ -176,29 +252,36 @@ void Renderer::_key_press_mappings(sf::Event& event, sf::RenderWindow& window, M
         break;
 
     // Increase max. iteration steps. High magnification needs lots of iterations!
+    // Choosing manually ends the automatic choice.
     case sf::Keyboard::A:
+        mandelbrot.auto_iterations = 0;
         mandelbrot.n_iter_max = mandelbrot.n_iter_max >> 1 < 16U ? 16U : mandelbrot.n_iter_max >> 1;
         break;
 
     case sf::Keyboard::D:
-        mandelbrot.n_iter_max = mandelbrot.n_iter_max << 1 > 32768U ? 32768U : mandelbrot.n_iter_max << 1;
+        mandelbrot.auto_iterations = 0;
+        mandelbrot.n_iter_max = std::min(mandelbrot.n_iter_max << 1, MAX_ITERATIONS);
+        break;
+
+    case sf::Keyboard::I:
+        mandelbrot.auto_iterations = mandelbrot.auto_iterations > 0 ? 0 : MAX_ITERATIONS;
         break;
 
     // Shift center with VIM keys
     case sf::Keyboard::H:
-        mandelbrot.center_point.real -= (0.1L / mandelbrot.magnification);
+        mandelbrot.move(-0.1L, 0);
         break;
 
     case sf::Keyboard::J:
-        mandelbrot.center_point.imag -= (0.1L / mandelbrot.magnification);
+        mandelbrot.move(0, -0.1L);
         break;
 
     case sf::Keyboard::K:
-        mandelbrot.center_point.imag += (0.1L / mandelbrot.magnification);
+        mandelbrot.move(0, 0.1L);
         break;
 
     case sf::Keyboard::L:
-        mandelbrot.center_point.real += (0.1L / mandelbrot.magnification);
+        mandelbrot.move(0.1L, 0);
         break;
 
     default:
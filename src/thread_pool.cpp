@@ -0,0 +1,69 @@
+#include "thread_pool.hpp"
+#include "trace.hpp"
+
+#include <string>
+
+namespace {
+
+unsigned int shared_size = 0;
+
+} // namespace
+
+ThreadPool::ThreadPool(unsigned int n_threads) {
+    if (n_threads == 0)
+        n_threads = std::thread::hardware_concurrency();
+    if (n_threads == 0)
+        n_threads = 2;
+
+    for (unsigned int i = 0; i < n_threads; i++)
+        _workers.emplace_back(&ThreadPool::_run, this, i);
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stopping = true;
+    }
+    _task_available.notify_all();
+
+    for (auto& worker : _workers)
+        worker.join();
+}
+
+unsigned int ThreadPool::size() const {
+    return _workers.size();
+}
+
+void ThreadPool::_enqueue(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _tasks.push(std::move(task));
+    }
+    _task_available.notify_one();
+}
+
+ThreadPool& ThreadPool::shared() {
+    static ThreadPool pool(shared_size);
+    return pool;
+}
+
+void ThreadPool::set_shared_size(unsigned int n_threads) {
+    shared_size = n_threads;
+}
+
+void ThreadPool::_run(unsigned int index) {
+    Trace::shared().set_thread_name("Worker " + std::to_string(index));
+
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _task_available.wait(lock, [this]() { return _stopping || !_tasks.empty(); });
+            if (_stopping && _tasks.empty())
+                return;
+            task = std::move(_tasks.front());
+            _tasks.pop();
+        }
+        task();
+    }
+}
@@ -0,0 +1,90 @@
+#include "tiff_writer.hpp"
+#include "image_writer.hpp"
+
+#include <algorithm>
+
+namespace {
+
+constexpr uint16_t TYPE_SHORT = 3;
+constexpr uint16_t TYPE_LONG = 4;
+constexpr uint16_t TYPE_LONG8 = 16;
+constexpr uint64_t IFD_OFFSET = 16;
+constexpr uint64_t N_ENTRIES = 11;
+constexpr uint64_t TABLES_OFFSET = 256;
+
+void put(std::vector<uint8_t>& out, uint64_t value, int size) {
+    for (int i = 0; i < size; i++)
+        out.push_back(value >> (8 * i));
+}
+
+void put_entry(std::vector<uint8_t>& out, uint16_t tag, uint16_t type, uint64_t count, uint64_t value) {
+    put(out, tag, 2);
+    put(out, type, 2);
+    put(out, count, 8);
+    put(out, value, 8);
+}
+
+} // namespace
+
+TiffWriter::TiffWriter(int fd, uint32_t width, uint32_t height) : _fd(fd), _width(width), _height(height) {
+    _tiles_x = (width + TILE_SIZE - 1) / TILE_SIZE;
+    const uint32_t tiles_y = (height + TILE_SIZE - 1) / TILE_SIZE;
+    const uint64_t n_tiles = uint64_t(_tiles_x) * tiles_y;
+    const uint64_t tile_bytes = uint64_t(TILE_SIZE) * TILE_SIZE * 3;
+
+    const uint64_t offsets_at = TABLES_OFFSET;
+    const uint64_t counts_at = offsets_at + 8 * n_tiles;
+    const uint64_t data_at = (counts_at + 8 * n_tiles + 15) / 16 * 16;
+
+    // Little endian BigTIFF header
+    std::vector<uint8_t> out = {'I', 'I', 43, 0, 8, 0, 0, 0};
+    put(out, IFD_OFFSET, 8);
+
+    put(out, N_ENTRIES, 8);
+    put_entry(out, 256, TYPE_LONG, 1, width);
+    put_entry(out, 257, TYPE_LONG, 1, height);
+    put_entry(out, 258, TYPE_SHORT, 3, 0x0008'0008'0008ULL); // Bits per sample, inline
+    put_entry(out, 259, TYPE_SHORT, 1, 1);                    // No compression
+    put_entry(out, 262, TYPE_SHORT, 1, 2);                    // RGB
+    put_entry(out, 277, TYPE_SHORT, 1, 3);                    // Samples per pixel
+    put_entry(out, 284, TYPE_SHORT, 1, 1);                    // Interleaved
+    put_entry(out, 322, TYPE_LONG, 1, TILE_SIZE);
+    put_entry(out, 323, TYPE_LONG, 1, TILE_SIZE);
+    // Tables with a single entry are stored inline
+    put_entry(out, 324, TYPE_LONG8, n_tiles, n_tiles == 1 ? data_at : offsets_at);
+    put_entry(out, 325, TYPE_LONG8, n_tiles, n_tiles == 1 ? tile_bytes : counts_at);
+    put(out, 0, 8); // No further IFD
+
+    out.resize(TABLES_OFFSET, 0);
+    for (uint64_t i = 0; i < n_tiles; i++)
+        put(out, data_at + i * tile_bytes, 8);
+    for (uint64_t i = 0; i < n_tiles; i++)
+        put(out, tile_bytes, 8);
+    out.resize(data_at, 0);
+
+    write_all(_fd, out.data(), out.size());
+
+    _tile_row.assign(size_t(_tiles_x) * tile_bytes, 0);
+}
+
+void TiffWriter::write_rows(const uint8_t* rgba, uint32_t n_rows) {
+    const size_t tile_bytes = size_t(TILE_SIZE) * TILE_SIZE * 3;
+
+    for (uint32_t row = 0; row < n_rows; row++, _rows_written++) {
+        const uint8_t* source = rgba + size_t(row) * _width * 4;
+
+        for (uint32_t x = 0; x < _width; x++) {
+            uint8_t* tile = &_tile_row[size_t(x / TILE_SIZE) * tile_bytes];
+            std::copy_n(source + 4 * size_t(x), 3, tile + (size_t(_rows_buffered) * TILE_SIZE + x % TILE_SIZE) * 3);
+        }
+
+        if (++_rows_buffered == TILE_SIZE || _rows_written + 1 == _height)
+            _write_tile_row();
+    }
+}
+
+void TiffWriter::_write_tile_row() {
+    write_all(_fd, _tile_row.data(), _tile_row.size());
+    std::fill(_tile_row.begin(), _tile_row.end(), 0);
+    _rows_buffered = 0;
+}
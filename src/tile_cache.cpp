@@ -0,0 +1,200 @@
+#include "tile_cache.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <stdexcept>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr char MAGIC[8] = {'M', 'B', 'T', 'I', 'L', 'E', 'S', '2'};
+constexpr size_t HEADER_SIZE = 4096;
+
+void hash_bytes(uint64_t& hash, const void* data, size_t size) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; i++)
+        hash = (hash ^ bytes[i]) * 1099511628211ULL;
+}
+
+} // namespace
+
+TileKey make_tile_key(long double pixel_size, uint32_t n_iter_max, uint32_t kernel) {
+    TileKey key = {};
+    int exponent = 0;
+    key.pixel_mantissa = uint64_t(std::ldexp(std::frexp(pixel_size, &exponent), 64));
+    key.pixel_exponent = exponent;
+    key.n_iter_max = n_iter_max;
+    key.kernel = kernel;
+    return key;
+}
+
+uint64_t hash_tile_key(const TileKey& key) {
+    uint64_t hash = 14695981039346656037ULL;
+    hash_bytes(hash, &key.x, sizeof(key.x));
+    hash_bytes(hash, &key.y, sizeof(key.y));
+    hash_bytes(hash, &key.pixel_mantissa, sizeof(key.pixel_mantissa));
+    hash_bytes(hash, &key.pixel_exponent, sizeof(key.pixel_exponent));
+    hash_bytes(hash, &key.n_iter_max, sizeof(key.n_iter_max));
+    hash_bytes(hash, &key.kernel, sizeof(key.kernel));
+    return hash;
+}
+
+struct TileCache::Header {
+    char magic[8];
+    uint32_t tile_width;
+    uint32_t tile_height;
+    uint64_t n_slots; // Power of two, at least twice `max_tiles`
+    uint64_t max_tiles;
+    uint64_t n_tiles;
+};
+
+struct TileCache::Slot {
+    TileKey key;
+    uint64_t tile; // Index of the tile plus one, zero marks an empty slot
+};
+
+TileCache::TileCache(const std::string& path, size_t size) {
+    _fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (_fd < 0)
+        throw std::runtime_error("Cannot open " + path + ": " + std::strerror(errno));
+
+    if (flock(_fd, LOCK_EX | LOCK_NB) != 0) {
+        ::close(_fd);
+        throw std::runtime_error("Tile cache " + path + " is in use by another process");
+    }
+
+    struct stat info;
+    if (fstat(_fd, &info) != 0) {
+        ::close(_fd);
+        throw std::runtime_error("Cannot stat " + path + ": " + std::strerror(errno));
+    }
+    const uint64_t file_size = uint64_t(info.st_size);
+
+    // Open addressing needs a power of two of at least twice the tiles.
+    const auto slots_for = [](uint64_t max_tiles) {
+        uint64_t n_slots = 1;
+        while (n_slots < 2 * max_tiles)
+            n_slots <<= 1;
+        return n_slots;
+    };
+
+    Header existing = {};
+    bool valid = file_size >= HEADER_SIZE && ::pread(_fd, &existing, sizeof(existing), 0) == sizeof(existing) &&
+                 std::equal(MAGIC, MAGIC + sizeof(MAGIC), existing.magic) && existing.tile_width == TILE_WIDTH &&
+                 existing.tile_height == TILE_HEIGHT;
+
+    // A truncated or corrupt file would fault once mapped, it is created again.
+    if (valid && !(existing.max_tiles > 0 && existing.max_tiles <= file_size / TILE_BYTES &&
+                   existing.n_tiles <= existing.max_tiles && existing.n_slots == slots_for(existing.max_tiles) &&
+                   file_size >= HEADER_SIZE + existing.n_slots * sizeof(Slot) + existing.max_tiles * TILE_BYTES)) {
+        std::cerr << "[INFO] Tile cache " << path << " is damaged, starting over" << std::endl;
+        valid = false;
+    }
+
+    const uint64_t max_tiles = valid ? existing.max_tiles : std::max<uint64_t>(1, size / TILE_BYTES);
+    const uint64_t n_slots = slots_for(max_tiles);
+    _size = HEADER_SIZE + n_slots * sizeof(Slot) + max_tiles * TILE_BYTES;
+
+    // The file is sparse, disk space is only used by tiles actually written.
+    if (!valid && (::ftruncate(_fd, 0) != 0 || ::ftruncate(_fd, _size) != 0)) {
+        ::close(_fd);
+        throw std::runtime_error("Cannot create " + path + ": " + std::strerror(errno));
+    }
+
+    _mapping = mmap(nullptr, _size, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+    if (_mapping == MAP_FAILED) {
+        ::close(_fd);
+        throw std::runtime_error("Cannot map " + path + ": " + std::strerror(errno));
+    }
+
+    _header = static_cast<Header*>(_mapping);
+    _slots = reinterpret_cast<Slot*>(static_cast<uint8_t*>(_mapping) + HEADER_SIZE);
+    _tiles = reinterpret_cast<uint8_t*>(_slots + n_slots);
+
+    if (!valid) {
+        std::copy_n(MAGIC, sizeof(MAGIC), _header->magic);
+        _header->tile_width = TILE_WIDTH;
+        _header->tile_height = TILE_HEIGHT;
+        _header->n_slots = n_slots;
+        _header->max_tiles = max_tiles;
+        _header->n_tiles = 0;
+    }
+}
+
+TileCache::~TileCache() {
+    std::cerr << "[INFO] Tile cache: " << _hits << " hits, " << _misses << " misses, " << _header->n_tiles
+              << " tiles stored" << std::endl;
+
+    msync(_mapping, _size, MS_SYNC);
+    munmap(_mapping, _size);
+    ::close(_fd);
+}
+
+TileCache::Slot* TileCache::_find(const TileKey& key) {
+    const uint64_t mask = _header->n_slots - 1;
+
+    for (uint64_t i = hash_tile_key(key) & mask;; i = (i + 1) & mask) {
+        Slot* slot = &_slots[i];
+        if (slot->tile == 0 || slot->key == key)
+            return slot;
+    }
+}
+
+bool TileCache::lookup(const TileKey& key, uint32_t* iterations, float* smooth) {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    // Indices past the stored tiles only occur in corrupt files.
+    Slot* slot = _find(key);
+    if (slot->tile == 0 || slot->tile > _header->n_tiles) {
+        _misses++;
+        return false;
+    }
+
+    const uint8_t* tile = _tiles + (slot->tile - 1) * TILE_BYTES;
+    std::memcpy(iterations, tile, TILE_PIXELS * sizeof(uint32_t));
+    std::memcpy(smooth, tile + TILE_PIXELS * sizeof(uint32_t), TILE_PIXELS * sizeof(float));
+    _hits++;
+    return true;
+}
+
+void TileCache::insert(const TileKey& key, const uint32_t* iterations, const float* smooth) {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    if (_header->n_tiles == _header->max_tiles) {
+        std::cerr << "\n[INFO] Tile cache is full, starting over" << std::endl;
+        std::memset(_slots, 0, _header->n_slots * sizeof(Slot));
+        _header->n_tiles = 0;
+    }
+
+    Slot* slot = _find(key);
+    if (slot->tile != 0)
+        return;
+
+    uint8_t* tile = _tiles + _header->n_tiles * TILE_BYTES;
+    std::memcpy(tile, iterations, TILE_PIXELS * sizeof(uint32_t));
+    std::memcpy(tile + TILE_PIXELS * sizeof(uint32_t), smooth, TILE_PIXELS * sizeof(float));
+
+    slot->key = key;
+    slot->tile = ++_header->n_tiles;
+}
+
+std::unique_ptr<TileCache> open_tile_cache(const Options& options) {
+    if (!options.has("cache"))
+        return nullptr;
+
+    try {
+        return std::make_unique<TileCache>(options.get("cache", ""), std::stoull(options.get("cache-size", "1024"))
+                                                                          << 20);
+    }
+    catch (const std::runtime_error& e) {
+        std::cerr << "[INFO] " << e.what() << ", continuing without tile cache" << std::endl;
+        return nullptr;
+    }
+}
@@ -0,0 +1,105 @@
+#include "trace.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+Trace::Span::Span(const char* name, const char* category, const char* arg_name, int64_t arg)
+    : _name(name), _category(category), _arg_name(arg_name), _arg(arg), _start(-1.0) {
+    Trace& trace = Trace::shared();
+    if (trace.enabled())
+        _start = trace._now();
+}
+
+Trace::Span::~Span() {
+    Trace& trace = Trace::shared();
+    if (_start < 0.0 || !trace.enabled())
+        return;
+
+    trace._record({_name, _category, 'X', _thread_id(), _start, trace._now() - _start, _arg_name, _arg});
+}
+
+Trace& Trace::shared() {
+    static Trace trace;
+    return trace;
+}
+
+void Trace::enable() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _epoch = std::chrono::steady_clock::now();
+    _events.reserve(1 << 16);
+    _enabled = true;
+}
+
+void Trace::instant(const char* name, const char* category) {
+    if (enabled())
+        _record({name, category, 'i', _thread_id(), _now(), 0.0, nullptr, 0});
+}
+
+void Trace::set_thread_name(const std::string& name) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _thread_names[_thread_id()] = name;
+}
+
+double Trace::_now() const {
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - _epoch).count();
+}
+
+void Trace::_record(const Event& event) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_events.size() < MAX_EVENTS)
+        _events.push_back(event);
+    else
+        _dropped++;
+}
+
+int Trace::_thread_id() {
+    static std::atomic<int> next_id = 1;
+    thread_local int id = next_id++;
+    return id;
+}
+
+void Trace::write(const std::string& path) const {
+    std::ofstream out(path);
+    if (!out)
+        throw std::runtime_error("Can not open " + path);
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+
+    char line[512];
+    bool first = true;
+    for (const auto& [tid, name] : _thread_names) {
+        std::snprintf(line, sizeof(line),
+                      "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, "
+                      "\"args\": {\"name\": \"%s\"}}",
+                      first ? "" : ",\n", tid, name.c_str());
+        out << line;
+        first = false;
+    }
+    for (const Event& event : _events) {
+        int n = std::snprintf(line, sizeof(line),
+                              "%s{\"name\": \"%s\", \"cat\": \"%s\", \"ph\": \"%c\", \"pid\": 1, \"tid\": %d, "
+                              "\"ts\": %.3f",
+                              first ? "" : ",\n", event.name, event.category, event.phase, event.tid, event.start);
+        if (event.phase == 'X')
+            n += std::snprintf(line + n, sizeof(line) - n, ", \"dur\": %.3f", event.duration);
+        else
+            n += std::snprintf(line + n, sizeof(line) - n, ", \"s\": \"t\"");
+        if (event.arg_name != nullptr)
+            n += std::snprintf(line + n, sizeof(line) - n, ", \"args\": {\"%s\": %lld}", event.arg_name,
+                               (long long)event.arg);
+        std::snprintf(line + n, sizeof(line) - n, "}");
+        out << line;
+        first = false;
+    }
+    out << "\n]}\n";
+
+    if (!out)
+        throw std::runtime_error("Can not write " + path);
+    std::cerr << "[INFO] " << _events.size() << " trace events written to " << path;
+    if (_dropped > 0)
+        std::cerr << ", " << _dropped << " dropped";
+    std::cerr << std::endl;
+}
@@ -0,0 +1,81 @@
+#include "y4m_writer.hpp"
+#include "colorizer.hpp"
+#include "image_writer.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <future>
+#include <string>
+
+namespace {
+
+constexpr char FRAME_HEADER[] = "FRAME\n";
+
+} // namespace
+
+Y4mWriter::Y4mWriter(int fd, uint32_t width, uint32_t height, uint32_t fps, ThreadPool& pool)
+    : _fd(fd), _width(width), _height(height), _pool(pool) {
+    const size_t chroma_size = size_t((width + 1) / 2) * ((height + 1) / 2);
+    const size_t header_size = sizeof(FRAME_HEADER) - 1;
+
+    // The frame header is part of the buffer, so a frame is a single write.
+    _frame.resize(header_size + size_t(width) * height + 2 * chroma_size);
+    std::memcpy(_frame.data(), FRAME_HEADER, header_size);
+
+    // Without XCOLORRANGE readers assume limited range (16 to 235).
+    std::string header = "YUV4MPEG2 W" + std::to_string(width) + " H" + std::to_string(height) + " F" +
+                         std::to_string(fps) + ":1 Ip A1:1 C420jpeg XCOLORRANGE=FULL\n";
+    write_all(_fd, reinterpret_cast<const uint8_t*>(header.data()), header.size());
+}
+
+void Y4mWriter::write_frame(const uint8_t* rgba) {
+    std::vector<std::future<void>> futures;
+
+    for (uint32_t y = 0; y < _height; y += BAND_HEIGHT)
+        futures.push_back(_pool.submit([&, y]() { _convert_rows(rgba, y, std::min(y + BAND_HEIGHT, _height)); }));
+    for (auto& future : futures)
+        future.get();
+
+    write_all(_fd, _frame.data(), _frame.size());
+}
+
+void Y4mWriter::_convert_rows(const uint8_t* rgba, uint32_t y_start, uint32_t y_end) {
+    const uint32_t chroma_width = (_width + 1) / 2;
+    const size_t chroma_size = size_t(chroma_width) * ((_height + 1) / 2);
+    uint8_t* luma = _frame.data() + sizeof(FRAME_HEADER) - 1;
+    uint8_t* cb = luma + size_t(_width) * _height;
+    uint8_t* cr = cb + chroma_size;
+
+    // Fixed point with 8 fractional bits, plain loops over bytes which the
+    // compiler vectorizes.
+    for (uint32_t y = y_start; y < y_end; y++) {
+        const uint8_t* in = rgba + size_t(y) * _width * Colorizer::RGBA_SIZE;
+        uint8_t* out = luma + size_t(y) * _width;
+
+        for (uint32_t x = 0; x < _width; x++) {
+            const uint32_t r = in[4 * x], g = in[4 * x + 1], b = in[4 * x + 2];
+            out[x] = uint8_t((77 * r + 150 * g + 29 * b + 128) >> 8);
+        }
+    }
+
+    // Chroma of 2x2 blocks, the last row and column are repeated for odd sizes.
+    // Bands have an even height, so every block lies within one band.
+    for (uint32_t y = y_start; y < y_end; y += 2) {
+        const uint8_t* top = rgba + size_t(y) * _width * Colorizer::RGBA_SIZE;
+        const uint8_t* bottom = rgba + size_t(std::min(y + 1, _height - 1)) * _width * Colorizer::RGBA_SIZE;
+        uint8_t* out_cb = cb + size_t(y / 2) * chroma_width;
+        uint8_t* out_cr = cr + size_t(y / 2) * chroma_width;
+
+        for (uint32_t x = 0; x < chroma_width; x++) {
+            const size_t left = 8 * size_t(x);
+            const size_t right = 4 * size_t(std::min(2 * x + 1, _width - 1));
+
+            const int32_t r = top[left] + top[right] + bottom[left] + bottom[right];
+            const int32_t g = top[left + 1] + top[right + 1] + bottom[left + 1] + bottom[right + 1];
+            const int32_t b = top[left + 2] + top[right + 2] + bottom[left + 2] + bottom[right + 2];
+
+            out_cb[x] = uint8_t(std::min((-43 * r - 85 * g + 128 * b + (128 << 10) + 512) >> 10, 255));
+            out_cr[x] = uint8_t(std::min((128 * r - 107 * g - 21 * b + (128 << 10) + 512) >> 10, 255));
+        }
+    }
+}
@@ -0,0 +1,53 @@
+# Exports the same frame twice with one cache file. The second process has to
+# find every tile the first one stored. A truncated cache file is created
+# again instead of crashing the export.
+#
+# cmake -DMANDELBROT=path/to/Mandelbrot -DCACHE=path/to/file.tiles -P tile_cache_reuse.cmake
+
+# Sets <run>_HITS, <run>_MISSES and <run>_TILES from the statistics of one export.
+function(export_frame RUN)
+  execute_process(
+      COMMAND "${MANDELBROT}" 320 176 -0.743643887 +0.131825904 1000 100 --cache=${CACHE} --cache-size=16
+      OUTPUT_FILE /dev/null
+      ERROR_VARIABLE LOG
+      RESULT_VARIABLE RESULT)
+
+  if(NOT RESULT EQUAL 0)
+    message(FATAL_ERROR "${RUN} run failed (${RESULT}):\n${LOG}")
+  endif()
+
+  string(REGEX MATCH "Tile cache: ([0-9]+) hits, ([0-9]+) misses, ([0-9]+) tiles stored" STATS "${LOG}")
+  if(NOT STATS)
+    message(FATAL_ERROR "${RUN} run did not report the tile cache:\n${LOG}")
+  endif()
+  message(STATUS "${RUN} run: ${STATS}")
+
+  set(${RUN}_HITS ${CMAKE_MATCH_1} PARENT_SCOPE)
+  set(${RUN}_MISSES ${CMAKE_MATCH_2} PARENT_SCOPE)
+  set(${RUN}_TILES ${CMAKE_MATCH_3} PARENT_SCOPE)
+endfunction()
+
+file(REMOVE "${CACHE}")
+
+export_frame(first)
+export_frame(second)
+
+if(NOT first_MISSES GREATER 0 OR NOT second_MISSES EQUAL 0 OR NOT second_HITS EQUAL first_MISSES
+   OR NOT second_TILES EQUAL first_TILES)
+  message(FATAL_ERROR "The second run did not reuse the tiles of the first one")
+endif()
+
+# Only the header is left, the index and tiles it describes are gone.
+execute_process(COMMAND truncate -s 4096 "${CACHE}" RESULT_VARIABLE RESULT)
+if(NOT RESULT EQUAL 0)
+  message(FATAL_ERROR "Cannot truncate ${CACHE}")
+endif()
+
+export_frame(truncated)
+export_frame(recreated)
+
+file(REMOVE "${CACHE}")
+
+if(NOT truncated_HITS EQUAL 0 OR NOT truncated_MISSES EQUAL first_MISSES OR NOT recreated_MISSES EQUAL 0)
+  message(FATAL_ERROR "The truncated cache file was not created again")
+endif()
@@ -0,0 +1,315 @@
+#include "mandelbrot.hpp"
+#include "options.hpp"
+#include "perf_counters.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <numeric>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Runs the escape-time kernels over every preset at fixed sizes, iteration
+// limits and magnifications, and reports the throughput as CSV or JSON, so
+// results can be compared between commits. With --scaling one viewport is
+// rendered with 1, 2, 4, ... worker threads instead, to see where adding
+// threads stops paying off.
+//
+//     ./bin/MandelbrotBenchmark --format=json > benchmark.json
+//     ./bin/MandelbrotBenchmark --scaling --preset=9 --width=1280 --height=720
+
+namespace {
+
+struct Result {
+    int preset;
+    std::string kernel;
+    uint32_t n_iter_max;
+    long double magnification;
+    double seconds;     // Wall time of the fastest repetition
+    double cpu_seconds; // Process CPU time of the same repetition
+    double min_thread_seconds; // Busy time of the least loaded worker
+    double max_thread_seconds; // Busy time of the most loaded worker
+    double imbalance;   // Maximum over mean busy time of the workers
+    uint64_t iterations;
+    PerfCounters::Values counters; // Of the same repetition, with --perf
+};
+
+std::vector<std::string> split(const std::string& list) {
+    std::vector<std::string> items;
+    std::stringstream stream(list);
+    for (std::string item; std::getline(stream, item, ',');)
+        if (!item.empty())
+            items.push_back(item);
+    return items;
+}
+
+double cpu_time() {
+    timespec time;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &time);
+    return time.tv_sec + time.tv_nsec * 1e-9;
+}
+
+Result measure(Mandelbrot& mandelbrot, int repeat, const PerfCounters* counters) {
+    Result result = {};
+    result.seconds = 1e300;
+    for (int i = 0; i < repeat; i++) {
+        mandelbrot.has_changed = true;
+        const PerfCounters::Values counters_start = counters != nullptr ? counters->read() : PerfCounters::Values();
+        const double cpu_start = cpu_time();
+        const auto start = std::chrono::steady_clock::now();
+        mandelbrot.update();
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        if (elapsed.count() < result.seconds) {
+            result.seconds = elapsed.count();
+            result.cpu_seconds = cpu_time() - cpu_start;
+            result.imbalance = mandelbrot.imbalance();
+            const auto [least, most] = std::minmax_element(
+                mandelbrot.worker_stats().begin(), mandelbrot.worker_stats().end(),
+                [](const auto& a, const auto& b) { return a.busy_time < b.busy_time; });
+            result.min_thread_seconds = least->busy_time;
+            result.max_thread_seconds = most->busy_time;
+            if (counters != nullptr) {
+                const PerfCounters::Values values = counters->read();
+                for (size_t c = 0; c < PerfCounters::N_COUNTERS; c++)
+                    result.counters[c] = values[c] - counters_start[c];
+            }
+        }
+    }
+    const size_t n_pixels = size_t(mandelbrot.width) * mandelbrot.height;
+    result.iterations = std::accumulate(mandelbrot.iterations, mandelbrot.iterations + n_pixels, uint64_t(0));
+    return result;
+}
+
+class Report {
+  private:
+    std::ostream& _out;
+    bool _json;
+    uint32_t _width, _height;
+    unsigned int _threads;
+    bool _perf;
+    bool _first = true;
+
+  public:
+    Report(std::ostream& out, bool json, uint32_t width, uint32_t height, unsigned int threads, bool perf)
+        : _out(out), _json(json), _width(width), _height(height), _threads(threads), _perf(perf) {
+        if (_json)
+            _out << "{\"width\": " << _width << ", \"height\": " << _height << ", \"threads\": " << _threads
+                 << ", \"results\": [\n";
+        else
+            _out << "preset,kernel,width,height,threads,n_iter_max,magnification,seconds,cpu_seconds,"
+                    "min_thread_seconds,max_thread_seconds,imbalance,mpixels_per_s,iterations_per_s,iterations"
+                 << (_perf ? ",cycles,instructions,ipc,cache_misses_per_pixel,branch_misses_per_pixel,raw_per_pixel"
+                           : "")
+                 << "\n";
+    }
+
+    ~Report() {
+        if (_json)
+            _out << "\n]}\n";
+    }
+
+    void add(const Result& result) {
+        const double mpixels = double(_width) * _height / 1e6;
+        char line[512];
+        if (_json)
+            std::snprintf(line, sizeof(line),
+                          "%s  {\"preset\": %d, \"kernel\": \"%s\", \"n_iter_max\": %u, \"magnification\": %.6Lg, "
+                          "\"seconds\": %.6f, \"cpu_seconds\": %.6f, \"min_thread_seconds\": %.6f, "
+                          "\"max_thread_seconds\": %.6f, \"imbalance\": %.3f, \"mpixels_per_s\": %.3f, "
+                          "\"iterations_per_s\": %.6g, \"iterations\": %llu",
+                          _first ? "" : ",\n", result.preset, result.kernel.c_str(), result.n_iter_max,
+                          result.magnification, result.seconds, result.cpu_seconds, result.min_thread_seconds,
+                          result.max_thread_seconds, result.imbalance, mpixels / result.seconds,
+                          result.iterations / result.seconds, (unsigned long long)result.iterations);
+        else
+            std::snprintf(line, sizeof(line), "%d,%s,%u,%u,%u,%u,%.6Lg,%.6f,%.6f,%.6f,%.6f,%.3f,%.3f,%.6g,%llu",
+                          result.preset, result.kernel.c_str(), _width, _height, _threads, result.n_iter_max,
+                          result.magnification, result.seconds, result.cpu_seconds, result.min_thread_seconds,
+                          result.max_thread_seconds, result.imbalance, mpixels / result.seconds,
+                          result.iterations / result.seconds, (unsigned long long)result.iterations);
+        _out << line;
+
+        if (_perf) {
+            using Counter = PerfCounters::Counter;
+            const PerfCounters::Values& counters = result.counters;
+            const double pixels = double(_width) * _height;
+            const double cycles = counters[size_t(Counter::CYCLES)];
+            const double instructions = counters[size_t(Counter::INSTRUCTIONS)];
+            std::snprintf(line, sizeof(line),
+                          _json ? ", \"cycles\": %.0f, \"instructions\": %.0f, \"ipc\": %.3f, "
+                                  "\"cache_misses_per_pixel\": %.4f, \"branch_misses_per_pixel\": %.4f, "
+                                  "\"raw_per_pixel\": %.4f"
+                                : ",%.0f,%.0f,%.3f,%.4f,%.4f,%.4f",
+                          cycles, instructions, cycles > 0 ? instructions / cycles : 0.0,
+                          counters[size_t(Counter::CACHE_MISSES)] / pixels,
+                          counters[size_t(Counter::BRANCH_MISSES)] / pixels, counters[size_t(Counter::RAW)] / pixels);
+            _out << line;
+        }
+        _out << (_json ? "}" : "\n") << std::flush;
+        _first = false;
+    }
+};
+
+// 1, 2, 4, ... up to and including `max_threads`.
+std::vector<unsigned int> thread_counts(unsigned int max_threads) {
+    std::vector<unsigned int> counts;
+    for (unsigned int n = 1; n < max_threads; n *= 2)
+        counts.push_back(n);
+    counts.push_back(max_threads);
+    return counts;
+}
+
+// Renders the viewport of the options with every kernel on pools of
+// increasing size, and reports the speedup and parallel efficiency over one
+// thread together with the imbalance of the workers.
+void scaling(const Options& options, uint32_t width, uint32_t height, int repeat,
+             const std::vector<std::string>& kernels, uint32_t n_iter_max, bool json, std::ostream& out) {
+    constexpr int n_presets = sizeof(PRESETS) / sizeof(PRESETS[0]);
+    const int preset = std::stoi(options.get("preset", "1"));
+    if (preset < 1 || preset > n_presets)
+        throw std::invalid_argument("Preset must be between 1 and " + std::to_string(n_presets));
+    const std::string real = options.get("real", PRESETS[preset - 1][0]);
+    const std::string imag = options.get("imag", PRESETS[preset - 1][1]);
+    const Complex center = {parse_coordinate(real), parse_coordinate(imag)};
+    const long double magnification = std::stold(options.get("magnification", "1"));
+
+    unsigned int max_threads = std::stoul(options.get("threads", "0"));
+    if (max_threads == 0)
+        max_threads = std::max(1u, std::thread::hardware_concurrency());
+
+    if (json)
+        out << "{\"width\": " << width << ", \"height\": " << height << ", \"real\": \"" << real
+            << "\", \"imag\": \"" << imag << "\", \"magnification\": " << double(magnification) << ", \"n_iter_max\": " << n_iter_max
+            << ", \"results\": [\n";
+    else
+        out << "kernel,threads,seconds,cpu_seconds,speedup,efficiency,imbalance,mpixels_per_s\n";
+
+    const double mpixels = double(width) * height / 1e6;
+    char line[512];
+    bool first = true;
+    for (const std::string& kernel : kernels) {
+        double single_thread = 0.0;
+        unsigned int last_efficient = 1;
+        for (unsigned int n_threads : thread_counts(max_threads)) {
+            // A pool per size, so no idle workers of a larger one are around.
+            ThreadPool pool(n_threads);
+            Mandelbrot mandelbrot(width, height, pool);
+            mandelbrot.kernel = Mandelbrot::parse_kernel(kernel);
+            mandelbrot.n_iter_max = n_iter_max;
+            mandelbrot.center_point = center;
+            mandelbrot.magnification = magnification;
+
+            const Result result = measure(mandelbrot, repeat, nullptr);
+            if (n_threads == 1)
+                single_thread = result.seconds;
+            const double speedup = single_thread / result.seconds;
+            const double efficiency = speedup / n_threads;
+            if (efficiency >= 0.8)
+                last_efficient = n_threads;
+
+            std::snprintf(line, sizeof(line),
+                          json ? "%s  {\"kernel\": \"%s\", \"threads\": %u, \"seconds\": %.6f, "
+                                 "\"cpu_seconds\": %.6f, \"speedup\": %.3f, \"efficiency\": %.3f, "
+                                 "\"imbalance\": %.3f, \"mpixels_per_s\": %.3f}"
+                               : "%s%s,%u,%.6f,%.6f,%.3f,%.3f,%.3f,%.3f\n",
+                          json ? (first ? "" : ",\n") : "", kernel.c_str(), n_threads, result.seconds,
+                          result.cpu_seconds, speedup, efficiency, result.imbalance, mpixels / result.seconds);
+            out << line << std::flush;
+            first = false;
+        }
+        std::cerr << "[INFO] " << kernel << ": parallel efficiency stays at 80% or above up to " << last_efficient
+                  << " threads" << std::endl;
+    }
+
+    if (json)
+        out << "\n]}\n";
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    try {
+        Options options(argc, argv);
+        const uint32_t width = std::stoul(options.get("width", "256"));
+        const uint32_t height = std::stoul(options.get("height", "144"));
+        const int repeat = std::max(1, std::stoi(options.get("repeat", "3")));
+        const std::vector<std::string> kernels = split(options.get("kernels", "direct,perturbation"));
+        const std::vector<std::string> iteration_limits = split(options.get("iterations", "1000"));
+        const std::vector<std::string> magnifications = split(options.get("magnifications", "1,1e6,1e12"));
+
+        const std::string format = options.get("format", "csv");
+        if (format != "csv" && format != "json")
+            throw std::invalid_argument("Unknown benchmark format: " + format);
+
+        std::ofstream file;
+        if (options.has("output")) {
+            file.open(options.get("output", ""));
+            if (!file)
+                throw std::runtime_error("Can not open " + options.get("output", ""));
+        }
+        std::ostream& out = file.is_open() ? file : std::cout;
+
+        if (options.has("scaling")) {
+            scaling(options, width, height, repeat, kernels, std::stoul(iteration_limits.at(0)), format == "json",
+                    out);
+            return 0;
+        }
+
+        // Before the pool, so its workers are counted.
+        std::unique_ptr<PerfCounters> counters;
+        if (options.has("perf"))
+            counters = std::make_unique<PerfCounters>(std::stoull(options.get("perf-raw", "0"), nullptr, 0));
+
+        ThreadPool pool(std::stoul(options.get("threads", "0")));
+        Mandelbrot mandelbrot(width, height, pool);
+
+        constexpr int n_presets = sizeof(PRESETS) / sizeof(PRESETS[0]);
+        double total_seconds = 0;
+        double total_iterations = 0;
+        size_t n_runs = 0;
+        {
+            Report report(out, format == "json", width, height, pool.size(), counters != nullptr);
+            for (const std::string& kernel : kernels) {
+                mandelbrot.kernel = Mandelbrot::parse_kernel(kernel);
+                for (const std::string& limit : iteration_limits) {
+                    mandelbrot.n_iter_max = std::stoul(limit);
+                    for (const std::string& magnification : magnifications) {
+                        mandelbrot.magnification = std::stold(magnification);
+                        for (int preset = 0; preset < n_presets; preset++) {
+                            mandelbrot.center_point = {parse_coordinate(PRESETS[preset][0]),
+                                                       parse_coordinate(PRESETS[preset][1])};
+
+                            Result result = measure(mandelbrot, repeat, counters.get());
+                            result.preset = preset + 1;
+                            result.kernel = kernel;
+                            result.n_iter_max = mandelbrot.n_iter_max;
+                            result.magnification = mandelbrot.magnification;
+                            report.add(result);
+
+                            total_seconds += result.seconds;
+                            total_iterations += result.iterations;
+                            n_runs++;
+                        }
+                    }
+                }
+            }
+        }
+
+        std::cerr << "[INFO] " << n_runs << " runs on " << pool.size() << " threads: "
+                  << n_runs * double(width) * height / 1e6 / total_seconds << " Mpixels/s, "
+                  << total_iterations / total_seconds << " iterations/s" << std::endl;
+    }
+    catch (const std::exception& e) {
+        std::cerr << "[ERROR] " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,263 @@
+#include "image_writer.hpp"
+#include "iteration_map.hpp"
+#include "mandelbrot.hpp"
+#include "options.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+// Renders a fixed corpus of viewports (every preset at several depths) and
+// compares the smooth iteration values against references computed with
+// GMP for every pixel, and the run time against a stored baseline. Fails if
+// either the output or the speed regressed.
+//
+//     ./bin/MandelbrotRegression --record    # once, writes regression/
+//     ./bin/MandelbrotRegression             # after every change
+
+namespace {
+
+constexpr int N_PRESETS = sizeof(PRESETS) / sizeof(PRESETS[0]);
+
+struct Viewport {
+    int preset;
+    std::string magnification; // Decimal, also part of the file names
+};
+
+struct Comparison {
+    size_t n_bad = 0;        // Pixels off by more than the tolerance or escaping in only one of both
+    double mean_error = 0.0; // Mean absolute difference of pixels escaping in both
+    double max_error = 0.0;
+};
+
+std::vector<std::string> split(const std::string& list) {
+    std::vector<std::string> items;
+    std::stringstream stream(list);
+    for (std::string item; std::getline(stream, item, ',');)
+        if (!item.empty())
+            items.push_back(item);
+    return items;
+}
+
+std::string reference_path(const std::string& directory, const Viewport& viewport) {
+    char name[64];
+    std::snprintf(name, sizeof(name), "preset-%02d-%s.itm", viewport.preset + 1, viewport.magnification.c_str());
+    return directory + "/" + name;
+}
+
+void set_viewport(Mandelbrot& mandelbrot, const Viewport& viewport) {
+    mandelbrot.center_point = {parse_coordinate(PRESETS[viewport.preset][0]),
+                               parse_coordinate(PRESETS[viewport.preset][1])};
+    mandelbrot.magnification = std::stold(viewport.magnification);
+}
+
+// Same pixel mapping and escape condition as the kernels, but every pixel is
+// computed from its exact coordinate with `precision` bits. Slow, only used
+// to record the references.
+void compute_reference(Mandelbrot& mandelbrot, const std::string& magnification, mp_bitcnt_t precision,
+                       ThreadPool& pool) {
+    const uint32_t width = mandelbrot.width, height = mandelbrot.height;
+    const mpf_class scale = mpf_class(4, precision) / mpf_class(magnification, precision, 10) / width;
+
+    auto row = [&](uint32_t y) {
+        const mpf_class c_imag(mandelbrot.center_point.imag - (y - height / 2.0) * scale, precision);
+        mpf_class c_real(0, precision), z_real(0, precision), z_imag(0, precision);
+        mpf_class real_squared(0, precision), imag_squared(0, precision);
+
+        for (uint32_t x = 0; x < width; x++) {
+            c_real = mandelbrot.center_point.real + (x - width / 2.0) * scale;
+            z_real = z_imag = real_squared = imag_squared = 0;
+
+            uint32_t n_iter = 0;
+            while (n_iter < mandelbrot.n_iter_max) {
+                z_imag = 2 * z_real * z_imag + c_imag;
+                z_real = real_squared - imag_squared + c_real;
+                real_squared = z_real * z_real;
+                imag_squared = z_imag * z_imag;
+                n_iter++;
+
+                if (real_squared + imag_squared >= double(Mandelbrot::BAILOUT))
+                    break;
+            }
+            mandelbrot.smooth[size_t(y) * width + x] =
+                Mandelbrot::smooth_iteration(n_iter, z_real.get_d(), z_imag.get_d());
+        }
+    };
+
+    std::vector<std::future<void>> rows;
+    for (uint32_t y = 0; y < height; y++)
+        rows.push_back(pool.submit([&row, y]() { row(y); }));
+    for (auto& future : rows)
+        future.get();
+}
+
+Comparison compare(const float* values, const float* reference, size_t n_pixels, double tolerance) {
+    Comparison result;
+    size_t n_escaped = 0;
+    for (size_t i = 0; i < n_pixels; i++) {
+        const bool interior = values[i] == Mandelbrot::INTERIOR;
+        if (interior != (reference[i] == Mandelbrot::INTERIOR)) {
+            result.n_bad++;
+            continue;
+        }
+        if (interior)
+            continue;
+
+        const double error = std::abs(double(values[i]) - reference[i]);
+        result.n_bad += error > tolerance;
+        result.mean_error += error;
+        result.max_error = std::max(result.max_error, error);
+        n_escaped++;
+    }
+    if (n_escaped > 0)
+        result.mean_error /= n_escaped;
+    return result;
+}
+
+double render(Mandelbrot& mandelbrot, int repeat) {
+    double best = 1e300;
+    for (int i = 0; i < repeat; i++) {
+        mandelbrot.has_changed = true;
+        const auto start = std::chrono::steady_clock::now();
+        mandelbrot.update();
+        best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+    return best;
+}
+
+// Baseline run times by "kernel preset magnification".
+std::map<std::string, double> read_baseline(const std::string& path) {
+    std::map<std::string, double> baseline;
+    std::ifstream in(path);
+    std::string kernel, magnification;
+    int preset;
+    double seconds;
+    while (in >> kernel >> preset >> magnification >> seconds)
+        baseline[kernel + " " + std::to_string(preset) + " " + magnification] = seconds;
+    return baseline;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    try {
+        Options options(argc, argv);
+        const std::string directory = options.get("references", "regression");
+        const uint32_t width = std::stoul(options.get("width", "96"));
+        const uint32_t height = std::stoul(options.get("height", "54"));
+        const uint32_t n_iter_max = std::stoul(options.get("iterations", "1000"));
+        const int repeat = std::max(1, std::stoi(options.get("repeat", "3")));
+        const double tolerance = std::stod(options.get("tolerance", "0.05"));
+        const double max_bad = std::stod(options.get("max-bad", "0.02"));
+        const double max_slowdown = std::stod(options.get("max-slowdown", "0.15"));
+        const std::vector<std::string> kernels = split(options.get("kernels", "direct,perturbation"));
+        const bool record = options.has("record");
+        const bool update_baseline = record || options.has("update-baseline");
+
+        std::vector<Viewport> corpus;
+        for (const std::string& magnification : split(options.get("magnifications", "1,1e5,1e10")))
+            for (int preset = 0; preset < N_PRESETS; preset++)
+                corpus.push_back({preset, magnification});
+
+        ThreadPool pool(std::stoul(options.get("threads", "0")));
+        Mandelbrot mandelbrot(width, height, pool);
+        mandelbrot.n_iter_max = n_iter_max;
+        std::filesystem::create_directories(directory);
+
+        if (record) {
+            std::cerr << "[INFO] Recording " << corpus.size() << " references to " << directory << " ..."
+                      << std::endl;
+            for (const Viewport& viewport : corpus) {
+                set_viewport(mandelbrot, viewport);
+                const mp_bitcnt_t precision = Mandelbrot::precision_bits(mandelbrot.magnification, width) + 64;
+                compute_reference(mandelbrot, viewport.magnification, precision, pool);
+
+                int fd = open_output_file(reference_path(directory, viewport));
+                IterationMapWriter(fd, mandelbrot, precision).write_rows(mandelbrot.smooth, 0, height);
+                ::close(fd);
+            }
+        }
+
+        const std::string baseline_path = directory + "/baseline.txt";
+        const std::map<std::string, double> baseline = read_baseline(baseline_path);
+        std::ofstream new_baseline;
+        if (update_baseline)
+            new_baseline.open(baseline_path);
+
+        const size_t n_pixels = size_t(width) * height;
+        std::vector<float> reference(n_pixels);
+        bool failed = false;
+
+        std::printf("%-13s %6s %6s %9s %10s %10s %10s %10s\n", "Kernel", "Preset", "Magn.", "Bad [%]", "Mean err",
+                    "Max err", "Time [ms]", "Baseline");
+        for (const std::string& kernel : kernels) {
+            mandelbrot.kernel = Mandelbrot::parse_kernel(kernel);
+            double total_time = 0.0, total_baseline = 0.0;
+            bool complete_baseline = true;
+
+            for (const Viewport& viewport : corpus) {
+                IterationMap map(reference_path(directory, viewport));
+                if (map.header->width != width || map.header->height != height ||
+                    map.header->n_iter_max != n_iter_max)
+                    throw std::runtime_error("References in " + directory +
+                                             " were recorded with other settings, run with --record");
+                map.read_rows(0, height, reference.data());
+
+                set_viewport(mandelbrot, viewport);
+                const double seconds = render(mandelbrot, repeat);
+                const Comparison result = compare(mandelbrot.smooth, reference.data(), n_pixels, tolerance);
+
+                const std::string key =
+                    kernel + " " + std::to_string(viewport.preset + 1) + " " + viewport.magnification;
+                auto it = baseline.find(key);
+                complete_baseline &= it != baseline.end();
+                total_time += seconds;
+                total_baseline += it != baseline.end() ? it->second : 0.0;
+                if (new_baseline.is_open())
+                    new_baseline << key << " " << seconds << "\n";
+
+                const double bad = double(result.n_bad) / n_pixels;
+                std::printf("%-13s %6d %6s %9.3f %10.5f %10.5f %10.3f %10.3f%s\n", kernel.c_str(), viewport.preset + 1,
+                            viewport.magnification.c_str(), bad * 100.0, result.mean_error, result.max_error,
+                            seconds * 1e3, it != baseline.end() ? it->second * 1e3 : 0.0,
+                            bad > max_bad ? "  FAILED" : "");
+                failed |= bad > max_bad;
+            }
+
+            if (!complete_baseline || update_baseline) {
+                std::cerr << "[INFO] " << kernel << ": " << total_time << " s, no baseline to compare" << std::endl;
+            }
+            else if (total_time > total_baseline * (1.0 + max_slowdown)) {
+                std::cerr << "[ERROR] " << kernel << ": " << total_time << " s, " << total_baseline
+                          << " s in the baseline" << std::endl;
+                failed = true;
+            }
+            else {
+                std::cerr << "[INFO] " << kernel << ": " << total_time << " s, " << total_baseline
+                          << " s in the baseline" << std::endl;
+            }
+        }
+
+        if (failed) {
+            std::cerr << "[ERROR] Regression test failed" << std::endl;
+            return 1;
+        }
+        std::cerr << "[INFO] Regression test passed" << std::endl;
+    }
+    catch (const std::exception& e) {
+        std::cerr << "[ERROR] " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}